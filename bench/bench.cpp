@@ -0,0 +1,297 @@
+/* Copyright (c) 2012 Guillaume Collet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * mstatx_bench generates synthetic alignments and times each phase of
+ * their analysis (see profile.h), the results are written in JSON.
+ *
+ * Usage: mstatx_bench [-p threads] [-r repeats] [-s statistics] [config ...]
+ * with config = NxL[:protein|dna[:gap_rate]], e.g. 20000x1000:dna:0.05
+ *
+ * An alignment of N sequences and L columns is generated for each
+ * config (the same alignment for the same config), then read and
+ * analysed repeats times. Each statistic is calculated and written
+ * in memory (the format is timed, not the disk). For each phase, the
+ * minimum and the median over the repeats of the wall-clock time and
+ * the medians of the CPU times are reported.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include <stdint.h>
+
+#include "msa.h"
+#include "options.h"
+#include "statistic.h"
+#include "profile.h"
+
+using namespace std;
+
+struct BenchConfig
+{
+	int    nseq;
+	int    ncol;
+	string alphabet;   /**< "protein" or "dna" */
+	double gap_rate;   /**< Probability of a gap */
+};
+
+/* xorshift64*, the alignments do not depend on the platform */
+class Random
+{
+	uint64_t state;
+public:
+	Random(uint64_t seed) : state(seed ? seed : 1) {};
+	uint64_t next(){
+		state ^= state >> 12;
+		state ^= state << 25;
+		state ^= state >> 27;
+		return state * 2685821657736338717ULL;
+	};
+	double uniform(){return (next() >> 11) * (1.0 / 9007199254740992.0);};	/**< In [0, 1[ */
+};
+
+/*
+ * Write a random alignment for config in fname. Each column has a
+ * dominant symbol and a conservation level drawn at random: a residue
+ * is a gap with probability gap_rate, else the dominant symbol with
+ * the probability of conservation, else a random symbol.
+ */
+static void
+generateAlignment(const BenchConfig & config, const string & fname)
+{
+	string symbols = config.alphabet == "dna" ? "ACGT" : "ACDEFGHIKLMNPQRSTVWY";
+	int K = (int) symbols.size();
+	Random rnd(((uint64_t) config.nseq << 32) ^ (uint64_t) config.ncol ^ (uint64_t) (config.gap_rate * 1e6) ^ K);
+	vector<char>   dominant(config.ncol);
+	vector<double> conservation(config.ncol);
+	for (int col(0); col < config.ncol; ++col){
+		dominant[col] = symbols[rnd.next() % K];
+		conservation[col] = rnd.uniform();
+	}
+	FILE * file = fopen(fname.c_str(), "wb");
+	if (file == NULL){
+		cerr << "Cannot write " << fname << "\n";
+		exit(0);
+	}
+	string row;
+	for (int seq(0); seq < config.nseq; ++seq){
+		row = ">seq" + to_string(seq) + "\n";
+		for (int col(0); col < config.ncol; ++col){
+			double u = rnd.uniform();
+			if (u < config.gap_rate){
+				row.push_back('-');
+			} else if (rnd.uniform() < conservation[col]){
+				row.push_back(dominant[col]);
+			} else {
+				row.push_back(symbols[rnd.next() % K]);
+			}
+			if (col % 60 == 59 || col == config.ncol - 1){
+				row.push_back('\n');
+			}
+		}
+		fwrite(row.data(), 1, row.size(), file);
+	}
+	fclose(file);
+}
+
+/* Parse NxL[:alphabet[:gap_rate]] */
+static BenchConfig
+parseConfig(const string & text)
+{
+	BenchConfig config = {0, 0, "protein", 0.1};
+	string size = text.substr(0, text.find(':'));
+	size_t x = size.find('x');
+	if (x != string::npos){
+		config.nseq = atoi(size.substr(0, x).c_str());
+		config.ncol = atoi(size.substr(x + 1).c_str());
+	}
+	if (text.find(':') != string::npos){
+		string rest = text.substr(text.find(':') + 1);
+		config.alphabet = rest.substr(0, rest.find(':'));
+		if (rest.find(':') != string::npos){
+			config.gap_rate = atof(rest.substr(rest.find(':') + 1).c_str());
+		}
+	}
+	if (config.nseq <= 0 || config.ncol <= 0 || (config.alphabet != "protein" && config.alphabet != "dna") || config.gap_rate < 0 || config.gap_rate >= 1){
+		cerr << "Wrong config " << text << " (NxL[:protein|dna[:gap_rate]])\n";
+		exit(0);
+	}
+	return config;
+}
+
+/* Parse the options of mstatx for one config, the output is not used */
+static void
+setOptions(const BenchConfig & config, const string & fname, const string & stats, const string & threads)
+{
+	vector<string> args = {"mstatx_bench", "-i", fname, "-s", stats, "-p", threads, "-o", "/dev/null"};
+	if (config.alphabet == "dna"){
+		args.push_back("-m");
+		args.push_back("DNA");
+	}
+	vector<char *> argv;
+	for (size_t i(0); i < args.size(); ++i){
+		argv.push_back(&args[i][0]);
+	}
+	try {
+		Options::Parse((int) argv.size(), &argv[0]);
+	} catch (exception &e) {
+		cerr << e.what() << "\n";
+		exit(0);
+	}
+}
+
+static double
+median(vector<double> values)
+{
+	sort(values.begin(), values.end());
+	size_t n = values.size();
+	return n == 0 ? 0.0 : (n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2);
+}
+
+/* Run the config repeats times, write its JSON object in out */
+static void
+runConfig(const BenchConfig & config, const string & stats, const string & threads, int repeats, ostream & out)
+{
+	char tmp_name[] = "/tmp/mstatx_benchXXXXXX";
+	int fd = mkstemp(tmp_name);
+	if (fd < 0){
+		cerr << "Cannot create a temporary file\n";
+		exit(0);
+	}
+	close(fd);
+	string fname = tmp_name;
+	generateAlignment(config, fname);
+	setOptions(config, fname, stats, threads);
+	const vector<string> & names = Options::Get().statistics;
+	
+	/* Time of each phase (in order of first run) for each repeat */
+	vector<string> order;
+	vector<vector<PhaseTime> > runs;
+	size_t out_bytes = 0;
+	for (int r(0); r < repeats; ++r){
+		Profile::reset();
+		out_bytes = 0;
+		{
+			ScopedTimer total("total");
+			Msa msa(fname);
+			for (size_t s(0); s < names.size(); ++s){
+				Statistic * stat = StatisticFactory::CreateByName(names[s]);
+				{
+					ScopedTimer timer("calculate " + names[s]);
+					stat->calculate(msa);
+				}
+				string result;
+				{
+					ScopedTimer timer("print " + names[s]);
+					Writer mem(&result);
+					stat->write(msa, mem);
+				}
+				out_bytes += result.size();
+				delete stat;
+			}
+		}
+		runs.push_back(Profile::phases());
+		for (size_t p(0); p < runs.back().size(); ++p){
+			if (find(order.begin(), order.end(), runs.back()[p].name) == order.end()){
+				order.push_back(runs.back()[p].name);
+			}
+		}
+	}
+	remove(fname.c_str());
+	
+	out << "  {\"nseq\": " << config.nseq << ", \"ncol\": " << config.ncol
+	    << ", \"alphabet\": \"" << config.alphabet << "\", \"gap_rate\": " << config.gap_rate
+	    << ", \"threads\": " << threads << ", \"repeats\": " << repeats
+	    << ", \"statistics\": \"" << stats << "\", \"output_bytes\": " << out_bytes << ",\n   \"phases\": [";
+	for (size_t p(0); p < order.size(); ++p){
+		vector<double> wall, cpu, thread_cpu;
+		int calls = 0;
+		for (size_t r(0); r < runs.size(); ++r){
+			for (size_t i(0); i < runs[r].size(); ++i){
+				if (runs[r][i].name == order[p]){
+					wall.push_back(runs[r][i].wall);
+					cpu.push_back(runs[r][i].cpu);
+					thread_cpu.push_back(runs[r][i].thread_cpu);
+					calls = runs[r][i].calls;
+				}
+			}
+		}
+		out << (p ? ",\n    " : "\n    ") << "{\"name\": \"" << order[p] << "\", \"calls\": " << calls
+		    << ", \"wall_min\": " << *min_element(wall.begin(), wall.end())
+		    << ", \"wall_median\": " << median(wall)
+		    << ", \"cpu_median\": " << median(cpu)
+		    << ", \"thread_cpu_median\": " << median(thread_cpu) << "}";
+	}
+	out << "\n   ]}";
+	cerr << config.nseq << "x" << config.ncol << " " << config.alphabet << " done\n";
+}
+
+int main(int argc, char ** argv)
+{
+	string threads = "1";
+	string stats = "wentropy,trident,mvector,jensen,kabat,gap";
+	int repeats = 5;
+	vector<BenchConfig> configs;
+	for (int i(1); i < argc; ++i){
+		string arg = argv[i];
+		if ((arg == "-p" || arg == "-r" || arg == "-s") && i + 1 < argc){
+			string value = argv[++i];
+			if (arg == "-p"){
+				threads = value;
+			} else if (arg == "-r"){
+				repeats = max(1, atoi(value.c_str()));
+			} else {
+				stats = value;
+			}
+		} else if (arg[0] == '-'){
+			cerr << "Usage: mstatx_bench [-p threads] [-r repeats] [-s statistics] [NxL[:protein|dna[:gap_rate]] ...]\n";
+			return 1;
+		} else {
+			configs.push_back(parseConfig(arg));
+		}
+	}
+	if (configs.empty()){
+		configs.push_back(parseConfig("2000x500:protein:0.1"));
+		configs.push_back(parseConfig("200x20000:protein:0.2"));
+		configs.push_back(parseConfig("20000x1000:dna:0.05"));
+	}
+	
+	AddAllStatistics();
+	Profile::enable(true);
+	/* The messages of mstatx on cout are dropped, the results go to the JSON stream */
+	ostream json(cout.rdbuf());
+	ofstream null("/dev/null");
+	cout.rdbuf(null.rdbuf());
+	json << "{\"benchmark\": \"mstatx\", \"configs\": [\n";
+	for (size_t c(0); c < configs.size(); ++c){
+		runConfig(configs[c], stats, threads, repeats, json);
+		json << (c + 1 < configs.size() ? ",\n" : "\n");
+	}
+	json << "]}\n";
+	json.flush();
+	cout.rdbuf(json.rdbuf());
+	return 0;
+}
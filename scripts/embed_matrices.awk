@@ -0,0 +1,93 @@
+# Copyright (c) 2012 Guillaume Collet
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+
+# Generates the tables of the embedded scoring matrices (embedded_matrices.inc)
+# from matrices in AAindex format:
+#   awk -f scripts/embed_matrices.awk data/aaindex/*.mat data/DNA.mat > src/embedded_matrices.inc
+# The matrices are named after their file (HENS920102.mat -> HENS920102).
+# The lower triangle is read like ScoringMatrix::readText (fields of 8
+# characters) and written as double literals; the tables are filled and
+# normalized at compile time (see embedded_matrices.cpp).
+# The matrices with a row i shorter than i fields of 8 characters
+# cannot be read by readText and are not embedded.
+
+function flush_matrix(   i, j, sep)
+{
+	if (name == "")
+		return
+	for (i = 0; i < size; i++) {
+		if (!(i in row) || length(row[i]) < 8 * i) {
+			printf("/* %s has no fields of 8 characters, not embedded */\n\n", name)
+			name = ""
+			delete row
+			return
+		}
+	}
+	printf("static constexpr double tri_%s[] = {", id)
+	sep = ""
+	for (i = 0; i < size; i++) {
+		for (j = 0; j <= i; j++) {
+			printf("%s%.17g", sep, (i in row) ? substr(row[i], j * 8 + 1, 8) + 0 : 0)
+			sep = ", "
+		}
+	}
+	printf("};\n")
+	printf("static constexpr MatrixTable<%d> table_%s = makeTable<%d>(tri_%s);\n\n", size, id, size, id)
+	list = list sprintf("\t{\"%s\", \"%s\", %d, table_%s.raw, table_%s.norm, table_%s.min, table_%s.max},\n", name, alphabet, size, id, id, id, id)
+	name = ""
+	delete row
+}
+
+BEGIN {
+	print "/* Generated by scripts/embed_matrices.awk, do not edit */"
+	print ""
+}
+
+FNR == 1 {
+	flush_matrix()
+	name = FILENAME
+	sub(/.*\//, "", name)
+	sub(/\.mat$/, "", name)
+	id = name
+	gsub(/[^A-Za-z0-9_]/, "_", id)
+	size = 0
+	nrow = -1
+}
+
+nrow >= 0 && nrow < size {
+	row[nrow] = $0
+	nrow++
+	next
+}
+
+nrow < 0 && /^M rows/ {
+	begin = index($0, "=") + 2
+	alphabet = substr($0, begin, index($0, ",") - begin)
+	gsub(/["\\]/, "", alphabet)
+	size = length(alphabet)
+	nrow = 0
+}
+
+END {
+	flush_matrix()
+	print "static const EmbeddedMatrix embedded_list[] = {"
+	printf("%s", list)
+	print "};"
+}
@@ -0,0 +1,64 @@
+/* Copyright (c) 2012 Guillaume Collet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __ALPHABET_H__
+#define __ALPHABET_H__
+
+#include <type_traits>
+
+/*
+ * Classes of alphabets. The kernels on encoded columns are instantiated
+ * for the maximum size of the alphabet of each class, so their tables
+ * have a size (and a row stride) known at compile time:
+ *   - nucleotide : ACGT/ACGU, gap and a few ambiguity codes (up to 8 symbols)
+ *   - protein    : 20 amino acids, gap and ambiguity codes (up to 32 symbols)
+ *   - generic    : any byte (up to 256 symbols)
+ */
+enum AlphabetClass {
+	NUCLEOTIDE_ALPHABET = 8,
+	PROTEIN_ALPHABET    = 32,
+	GENERIC_ALPHABET    = 256
+};
+
+inline AlphabetClass alphabetClass(int K)
+{
+	return K <= NUCLEOTIDE_ALPHABET ? NUCLEOTIDE_ALPHABET : (K <= PROTEIN_ALPHABET ? PROTEIN_ALPHABET : GENERIC_ALPHABET);
+}
+
+/* Calls f(std::integral_constant<int, KMAX>()) with KMAX the size of
+ * the class of an alphabet of K symbols */
+template <class Function>
+void dispatchAlphabet(int K, Function f)
+{
+	switch (alphabetClass(K)){
+		case NUCLEOTIDE_ALPHABET:
+			f(std::integral_constant<int, NUCLEOTIDE_ALPHABET>());
+			break;
+		case PROTEIN_ALPHABET:
+			f(std::integral_constant<int, PROTEIN_ALPHABET>());
+			break;
+		default:
+			f(std::integral_constant<int, GENERIC_ALPHABET>());
+			break;
+	}
+}
+
+#endif
@@ -0,0 +1,95 @@
+/* Copyright (c) 2012 Guillaume Collet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "arena.h"
+
+#define ARENA_BLOCK (1 << 16)
+
+Arena :: ~Arena()
+{
+	for (size_t b(0); b < blocks.size(); ++b){
+		free(blocks[b]);
+	}
+}
+
+Arena &
+Arena :: local()
+{
+	static thread_local Arena arena;
+	return arena;
+}
+
+/* The memory is taken in the current block, or in the next one
+ * (allocated if needed, at least twice as large as the previous) */
+void *
+Arena :: take(size_t bytes)
+{
+	bytes = (bytes + 63) / 64 * 64;
+	if (block < blocks.size() && used + bytes <= sizes[block]){
+		void * p = blocks[block] + used;
+		used += bytes;
+		return p;
+	}
+	if (block < blocks.size()){
+		block++;
+	}
+	while (block < blocks.size() && bytes > sizes[block]){
+		block++;
+	}
+	if (block == blocks.size()){
+		size_t size = sizes.empty() ? ARENA_BLOCK : 2 * sizes.back();
+		if (size < bytes){
+			size = bytes;
+		}
+		void * p = NULL;
+		if (posix_memalign(&p, 64, size) != 0){
+			abort();
+		}
+		blocks.push_back((char *) p);
+		sizes.push_back(size);
+	}
+	used = bytes;
+	return blocks[block];
+}
+
+/* When all the memory is given back, several blocks are merged in
+ * one of their total size, so the next uses fit in a single block */
+void
+Arena :: release(size_t block_, size_t used_)
+{
+	block = block_;
+	used = used_;
+	if (block == 0 && used == 0 && blocks.size() > 1){
+		size_t total = 0;
+		for (size_t b(0); b < blocks.size(); ++b){
+			total += sizes[b];
+			free(blocks[b]);
+		}
+		blocks.clear();
+		sizes.clear();
+		void * p = NULL;
+		if (posix_memalign(&p, 64, total) != 0){
+			abort();
+		}
+		blocks.push_back((char *) p);
+		sizes.push_back(total);
+	}
+}
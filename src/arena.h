@@ -0,0 +1,94 @@
+/* Copyright (c) 2012 Guillaume Collet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <vector>
+#include <cstddef>
+#include <cstdlib>
+
+using namespace std;
+
+/*
+ * Arena is the scratch memory of a thread, allocated by blocks and
+ * handed out by moving a pointer. The memory is given back in the
+ * reverse order (see Scratch) and the blocks are kept, so once the
+ * arena has grown to the largest need of the loops of the thread,
+ * their working buffers cost no heap allocation.
+ */
+class Arena
+{
+private:
+	vector<char *> blocks;	/**< Blocks of memory, in the order of use */
+	vector<size_t> sizes;		/**< Size of each block */
+	size_t block;						/**< Block being used */
+	size_t used;						/**< Bytes used in this block */
+
+	Arena() : block(0), used(0) {};
+	Arena(const Arena &);
+	Arena & operator=(const Arena &);
+
+public:
+	~Arena();
+	static Arena & local();		/**< The arena of the calling thread */
+	void * take(size_t bytes);	/**< Returns bytes of memory aligned on 64 bytes */
+	void mark(size_t & block_, size_t & used_) const {block_ = block; used_ = used;};	/**< Current position, to give back what is taken after */
+	void release(size_t block_, size_t used_);	/**< Give back the memory taken since the position (block_, used_) */
+};
+
+/*
+ * Scratch takes working buffers from the arena of the calling thread
+ * and gives them back when it goes out of scope, e.g. once per chunk
+ * of columns of parallelFor. The buffers hold trivial types only.
+ */
+class Scratch
+{
+private:
+	Arena & arena;	/**< Arena of the thread */
+	size_t  block;	/**< Block of the arena at the creation */
+	size_t  used;		/**< Bytes used in this block at the creation */
+
+	Scratch(const Scratch &);
+	Scratch & operator=(const Scratch &);
+
+public:
+	Scratch() : arena(Arena::local()) {arena.mark(block, used);};
+	~Scratch(){arena.release(block, used);};
+
+	template <class T>
+	T * get(size_t size)	/**< Buffer of size values (not initialized) */
+	{
+		return (T *) arena.take(size * sizeof(T));
+	};
+
+	template <class T>
+	T * get(size_t size, T value)	/**< Buffer of size values set to value */
+	{
+		T * values = get<T>(size);
+		for (size_t i(0); i < size; ++i){
+			values[i] = value;
+		}
+		return values;
+	};
+};
+
+#endif
@@ -0,0 +1,56 @@
+/* Copyright (c) 2012 Guillaume Collet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __BACKGROUND_H__
+#define __BACKGROUND_H__
+
+/* Background distribution of amino acids
+ * These background frequencies are used in sca paper
+ * Returns 0 for the symbols which are not amino acids
+ */
+inline float backgroundFreq(char aa)
+{
+	switch (aa){
+		case 'A': return 0.073;
+		case 'C': return 0.025;
+		case 'D': return 0.050;
+		case 'E': return 0.061;
+		case 'F': return 0.042;
+		case 'G': return 0.072;
+		case 'H': return 0.023;
+		case 'I': return 0.053;
+		case 'K': return 0.064;
+		case 'L': return 0.089;
+		case 'M': return 0.023;
+		case 'N': return 0.043;
+		case 'P': return 0.052;
+		case 'Q': return 0.040;
+		case 'R': return 0.052;
+		case 'S': return 0.073;
+		case 'T': return 0.056;
+		case 'V': return 0.063;
+		case 'W': return 0.013;
+		case 'Y': return 0.033;
+		default : return 0.0;
+	}
+}
+
+#endif
@@ -0,0 +1,127 @@
+/* Copyright (c) 2012 Guillaume Collet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "bootstrap.h"
+#include "context.h"
+#include "parallel.h"
+#include "profile.h"
+#include "arena.h"
+
+#include <cmath>
+#include <iostream>
+#include <algorithm>
+
+/* SplitMix64 (Steele, Lea and Flood, 2014), a stream per replicate */
+static uint64_t
+nextRandom(uint64_t & state)
+{
+	uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+/* Value at rank p * (n - 1) of the n sorted values, interpolated between ranks */
+static float
+percentile(const float * sorted, int n, double p)
+{
+	double rank = p * (n - 1);
+	int low = (int) floor(rank);
+	int high = (low + 1 < n) ? low + 1 : low;
+	return (float) (sorted[low] + (rank - low) * (sorted[high] - sorted[low]));
+}
+
+void
+bootstrapStats(Msa & msa, const vector<string> & names, int nrep, uint64_t seed, vector<Stat1D *> & results)
+{
+	ScopedTimer timer("bootstrap");
+	int nstat = (int) names.size();
+	int N = msa.getNseq();
+	int L = msa.getNcol();
+	for (int s(0); s < nstat; ++s){
+		Statistic * stat = createStatistic(names[s]);
+		bool column = dynamic_cast<Stat1D *>(stat) != NULL;
+		delete stat;
+		if (!column){
+			cerr << "error : only the column statistics can be bootstrapped, not " << names[s] << "\n";
+			exit(0);
+		}
+	}
+	if (nrep <= 0){
+		return;
+	}
+	if (N == 0 || L == 0){
+		/* Nothing to resample, the summaries are empty */
+		for (int s(0); s < 3 * nstat; ++s){
+			vector<float> none;
+			results.push_back(new ResampledStat(none));
+		}
+		return;
+	}
+	
+	/* scores[s][b * L + x] is the score of column x for statistic s in replicate b */
+	vector<vector<float> > scores(nstat, vector<float>((size_t) nrep * L, 0.0));
+	Context quiet = Context::Get();
+	quiet.quiet = true;
+	quiet.verbose = false;
+	parallelFor(0, nrep, [&](int first, int last){
+		ContextScope scope(quiet);
+		vector<int> rows(N);
+		for (int b(first); b < last; ++b){
+			uint64_t state = seed * 0x100000001b3ULL + (uint64_t) b;
+			nextRandom(state);
+			for (int i(0); i < N; ++i){
+				rows[i] = (int) (((nextRandom(state) >> 32) * (uint64_t) N) >> 32);
+			}
+			Msa replicate(msa, rows, 0, L);
+			for (int s(0); s < nstat; ++s){
+				Stat1D * stat = (Stat1D *) createStatistic(names[s]);
+				stat->calculate(replicate);
+				const vector<float> & col_stat = stat->getColStat();
+				copy(col_stat.begin(), col_stat.end(), scores[s].begin() + (size_t) b * L);
+				delete stat;
+			}
+		}
+	}, 1);
+	
+	/* Mean and interval of each column, from the replicates in their order */
+	for (int s(0); s < nstat; ++s){
+		vector<float> mean(L), low(L), high(L);
+		parallelFor(0, L, [&](int first, int last){
+			Scratch scratch;
+			float * values = scratch.get<float>(nrep);
+			for (int x(first); x < last; ++x){
+				double total = 0.0;
+				for (int b(0); b < nrep; ++b){
+					values[b] = scores[s][(size_t) b * L + x];
+					total += values[b];
+				}
+				sort(values, values + nrep);
+				mean[x] = (float) (total / nrep);
+				low[x]  = percentile(values, nrep, 0.025);
+				high[x] = percentile(values, nrep, 0.975);
+			}
+		});
+		results.push_back(new ResampledStat(mean));
+		results.push_back(new ResampledStat(low));
+		results.push_back(new ResampledStat(high));
+	}
+}
@@ -0,0 +1,52 @@
+/* Copyright (c) 2012 Guillaume Collet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __BOOTSTRAP_H__
+#define __BOOTSTRAP_H__
+
+#include <stdint.h>
+
+#include "statistic.h"
+
+/*
+ * ResampledStat holds one summary of a column statistic over the
+ * bootstrap replicates (the mean or a bound of the interval).
+ */
+class ResampledStat : public Stat1D
+{
+	public:
+		ResampledStat(vector<float> & scores){col_stat.swap(scores);};
+};
+
+/*
+ * bootstrapStats(msa, names, nrep, seed, results) calculates the
+ * column statistics names on nrep replicates of msa, each one made of
+ * nseq sequences drawn with replacement, and appends to results, for
+ * each statistic, the mean of the replicates and the bounds of the 95%
+ * interval of each column (percentiles 2.5 and 97.5). The three
+ * summaries are empty if msa has no sequence or no column.
+ * The replicates are views of the encoded alignment run by the threads;
+ * the sequences of replicate b only depend on seed and b, so the results
+ * do not depend on the number of threads.
+ */
+void bootstrapStats(Msa & msa, const vector<string> & names, int nrep, uint64_t seed, vector<Stat1D *> & results);
+
+#endif
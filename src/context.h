@@ -0,0 +1,125 @@
+/* Copyright (c) 2012 Guillaume Collet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __CONTEXT_H_INCLUDED__
+#define __CONTEXT_H_INCLUDED__
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/*
+ * The settings read by the alignment and the statistics.
+ * The command line fills the one of Options, a program embedding
+ * the library fills its own contexts and installs them with a
+ * ContextScope around the calls (one context per thread at most).
+ * The default values are the ones of the command line.
+ */
+struct Context
+{
+	string input_fname;  // The file name of the multiple alignment */
+	string matrix_fname; // The file name of the scoring matrix (or the name of an embedded matrix) */
+	string matrix_path;  // The directory of the matrices given by name (SCORE_MAT_PATH or data/aaindex) */
+	string output_fname; // The name of the output file */
+	string statistic;    // The name of the statistic (or comma separated list of names) */
+	vector<string> statistics; // The names of the statistics to calculate */
+	int    nb_seq;       // The number of sequences to read in the multiple alignment (all if <= 0) */
+	bool   verbose;      // The switch for verbose mode */
+	bool   global;       // The switch to output only the global alignment score */
+	float  threshold;    // The threshold for correlation print */
+	float  factor_a;     // The factor applied to the first  member of trident score */
+	float  factor_b;     // The factor applied to the second member of trident score */
+	float  factor_c;     // The factor applied to the third  member of trident score */
+	vector<int> windows; // The numbers of side columns of the smoothed column statistics (none if empty) */
+	int    threads;      // The number of threads used to calculate the statistics */
+	bool   stream;       // The switch to read the alignment by blocks of sequences */
+	int    block_size;   // The number of sequences per block in stream mode */
+	string state_fname;  // The state file of the incremental mode (empty if not incremental) */
+	bool   matrix_cache; // The switch to read and write the binary cache of the scoring matrix */
+	bool   msa_cache;    // The switch to read and write the binary cache of the alignment */
+	string batch;        // The list or directory of multiple alignments in batch mode (empty if not in batch mode) */
+	bool   combined;     // The switch to write all the results of the batch in the output file */
+	string out_format;   // The format of the output files (tsv, csv or bin) */
+	string pair_format;  // The output format of pairwise statistics (sparse, dense, top or bin) */
+	int    top_k;        // The number of best pairs printed per column in top format */
+	bool   pair_sinks;   // The switch to keep only the pairs printed in sparse or top format, not the whole triangle (set by the command line) */
+	bool   profile;      // The switch to print the profile of the run */
+	string profile_json; // The file of the profile in JSON (empty if not written) */
+	vector<int> rows;    // The sequences of the view, numbered from 0 (all if empty) */
+	int    first_col;    // The first column of the view, numbered from 0 */
+	int    last_col;     // The column after the last one of the view (0 for the end of the alignment) */
+	int    bootstrap;    // The number of bootstrap replicates of the sequences (none if 0) */
+	int    seed;         // The seed of the draws of the bootstrap */
+	float  max_id;       // The maximum identity of the sequences kept by the identity filter (no filter if 1) */
+	bool   quiet;        // The switch to print nothing on the standard output (library use) */
+
+	Context():
+		matrix_fname("HENS920102"),
+		matrix_path("data/aaindex"),
+		output_fname("output.txt"),
+		statistic("wentropy"),
+		statistics(1, "wentropy"),
+		nb_seq(0),
+		verbose(false),
+		global(false),
+		threshold(0.8),
+		factor_a(1.0),
+		factor_b(0.5),
+		factor_c(3.0),
+		threads(1),
+		stream(false),
+		block_size(10000),
+		matrix_cache(false),
+		msa_cache(false),
+		combined(false),
+		out_format("tsv"),
+		pair_format("sparse"),
+		top_k(10),
+		pair_sinks(false),
+		profile(false),
+		first_col(0),
+		last_col(0),
+		bootstrap(0),
+		seed(1),
+		max_id(1.0),
+		quiet(false)
+	{};
+
+	/* The context of the current thread (the command line one if none is installed) */
+	static const Context & Get();
+};
+
+/* Installs a context in the current thread until the end of the scope */
+class ContextScope
+{
+	public:
+		ContextScope(const Context & ctx);
+		~ContextScope();
+
+	private:
+		const Context * previous; /**< The context installed before this one */
+
+		ContextScope(const ContextScope &);
+		ContextScope & operator=(const ContextScope &);
+};
+
+#endif
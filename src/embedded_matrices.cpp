@@ -0,0 +1,80 @@
+/* Copyright (c) 2012 Guillaume Collet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "embedded_matrices.h"
+
+#include <cstring>
+
+/*
+ * The lower triangle of each matrix is written in the generated file,
+ * the full and normalized tables are calculated at compile time with
+ * the same float operations as ScoringMatrix::readText, so an embedded
+ * matrix gives the same scores as its file.
+ */
+template <int K>
+struct MatrixTable {
+	static constexpr int S = (K + 7) / 8 * 8;
+	float raw[K * S];
+	float norm[K * S];
+	float min;
+	float max;
+};
+
+template <int K>
+constexpr MatrixTable<K>
+makeTable(const double (&tri)[K * (K + 1) / 2])
+{
+	constexpr int S = MatrixTable<K>::S;
+	MatrixTable<K> table = {};
+	table.min = 1000;
+	table.max = -1000;
+	int p = 0;
+	for (int i = 0; i < K; ++i){
+		for (int j = 0; j <= i; ++j){
+			float val = (float) tri[p++];
+			table.raw[i * S + j] = val;
+			table.raw[j * S + i] = val;
+			if (val < table.min)
+				table.min = val;
+			if (val > table.max)
+				table.max = val;
+		}
+	}
+	for (int i = 0; i < K; ++i){
+		for (int j = 0; j < K; ++j){
+			table.norm[i * S + j] = table.max > table.min ? (table.raw[i * S + j] - table.min) / (table.max - table.min) : 0;
+		}
+	}
+	return table;
+}
+
+#include "embedded_matrices.inc"
+
+const EmbeddedMatrix *
+findEmbeddedMatrix(const char * name)
+{
+	for (size_t m(0); m < sizeof(embedded_list) / sizeof(embedded_list[0]); ++m){
+		if (strcmp(embedded_list[m].name, name) == 0){
+			return &embedded_list[m];
+		}
+	}
+	return NULL;
+}
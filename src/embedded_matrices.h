@@ -0,0 +1,43 @@
+/* Copyright (c) 2012 Guillaume Collet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __EMBEDDED_MATRICES_H__
+#define __EMBEDDED_MATRICES_H__
+
+/*
+ * Scoring matrices compiled in the binary (data/aaindex, DNA and RNA),
+ * generated by scripts/embed_matrices.awk. The matrices are stored in
+ * full, size rows of (size + 7) / 8 * 8 floats, like in ScoringMatrix.
+ */
+struct EmbeddedMatrix {
+	const char *  name;      /**< Name of the matrix (file name without .mat) */
+	const char *  alphabet;  /**< Symbols of the rows and columns */
+	int           size;      /**< Size of the alphabet */
+	const float * raw;       /**< Scores */
+	const float * norm;      /**< Normalized scores (score - min) / (max - min) */
+	float         min;
+	float         max;
+};
+
+/* Returns the embedded matrix of this name (NULL if there is none) */
+const EmbeddedMatrix * findEmbeddedMatrix(const char * name);
+
+#endif
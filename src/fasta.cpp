@@ -0,0 +1,317 @@
+/* Copyright (c) 2012 Guillaume Collet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+
+#include "fasta.h"
+
+using namespace std;
+
+/**************************************************************
+ * indexFasta(data, size, max_seq, records) finds the records
+ * of a multi-fasta content. Headers are lines beginning by
+ * '>', they are found by jumping from '>' to '>' so sequence
+ * lines are not read. Lines before the first header are
+ * ignored.
+ **************************************************************/
+void
+indexFasta(const char * data, size_t size, int max_seq, vector<FastaRecord> & records)
+{
+	const char * end = data + size;
+	const char * p = data;
+	records.clear();
+	while (p < end && (max_seq < 0 || (int) records.size() < max_seq)){
+		p = (const char *) memchr(p, '>', end - p);
+		if (p == NULL){
+			break;
+		}
+		if (p != data && p[-1] != '\n'){
+			p++;
+			continue;
+		}
+		FastaRecord rec;
+		rec.name = p + 1;
+		const char * eol = (const char *) memchr(rec.name, '\n', end - rec.name);
+		if (eol == NULL){
+			eol = end;
+		}
+		rec.name_end = rec.name;
+		while (rec.name_end < eol && *rec.name_end != ' ' && *rec.name_end != '\r'){
+			rec.name_end++;
+		}
+		rec.seq = (eol < end) ? eol + 1 : end;
+		if (!records.empty()){
+			records.back().seq_end = p;
+		}
+		records.push_back(rec);
+		p = rec.seq;
+	}
+	if (!records.empty()){
+		/* The last record ends at the next header (not read) or at the end of data */
+		const char * q = records.back().seq;
+		while (q < end){
+			q = (const char *) memchr(q, '>', end - q);
+			if (q == NULL){
+				q = end;
+			} else if (q[-1] != '\n'){
+				q++;
+				continue;
+			}
+			break;
+		}
+		records.back().seq_end = q;
+	}
+}
+
+
+/**************************************************************
+ * countResidues() returns the number of residues of the
+ * record, end of lines ('\n' and '\r') are not residues
+ **************************************************************/
+int
+FastaRecord :: countResidues() const
+{
+	int n = 0;
+	for (const char * p(seq); p < seq_end; ++p){
+		if (*p != '\n' && *p != '\r'){
+			n++;
+		}
+	}
+	return n;
+}
+
+
+/** Upper case of each byte (toupper in the C locale) */
+static struct UpperCase
+{
+	uint8_t c[256];
+	UpperCase(){
+		for (int i(0); i < 256; ++i){
+			c[i] = (uint8_t) toupper(i);
+		}
+	}
+} upper_case;
+
+
+/**************************************************************
+ * decodeResidues(out, max_size) copies at most max_size
+ * residues of the record in out, in upper case, and returns
+ * the number of residues of the record.
+ * The lines that fit in out are copied without tests, a line
+ * with a '\r' (other than the last char) is copied char by char.
+ **************************************************************/
+int
+FastaRecord :: decodeResidues(uint8_t * out, int max_size) const
+{
+	int n = 0;
+	const char * p = seq;
+	while (p < seq_end){
+		const char * eol = (const char *) memchr(p, '\n', seq_end - p);
+		if (eol == NULL){
+			eol = seq_end;
+		}
+		int len = (int) (eol - p);
+		if (len > 0 && p[len - 1] == '\r'){
+			len--;
+		}
+		if (n + len <= max_size){
+			bool cr = false;
+			for (int i(0); i < len; ++i){
+				uint8_t c = (uint8_t) p[i];
+				cr |= (c == '\r');
+				out[n + i] = upper_case.c[c];
+			}
+			if (!cr){
+				n += len;
+				p = eol + 1;
+				continue;
+			}
+		}
+		for (; p < eol; ++p){
+			if (*p != '\r'){
+				if (n < max_size){
+					out[n] = upper_case.c[(unsigned char) *p];
+				}
+				n++;
+			}
+		}
+		p = eol + 1;
+	}
+	return n;
+}
+
+
+/** Constructor from a filename fname. */
+FastaStream :: FastaStream(string fname) : input(fname), a3m(false), buffer(1 << 20), begin(0), end(0), eof(false), has_header(false), buffer_pos(0), header_pos(0)
+{
+	AlignmentFormat format = detectFormat(fname, NULL, 0);
+	if (format == STOCKHOLM_FORMAT){
+		cerr << "error : the stream mode (-S) reads fasta or a2m/a3m files, not the Stockholm file " << fname << "\n";
+		exit(0);
+	}
+	a3m = (format == A3M_FORMAT);
+}
+
+/* Destructor */
+FastaStream :: ~FastaStream()
+{
+}
+
+/**************************************************************
+ * rewind() goes back to the beginning of the file
+ **************************************************************/
+void
+FastaStream :: rewind()
+{
+	seek(0);
+}
+
+/**************************************************************
+ * seek(offset) goes to offset in the file, which must be the
+ * beginning of a record (a header line) or the end of a file.
+ * nextOffset() returns the offset of the header of the next
+ * record, then seek(nextOffset()) reads again this record.
+ **************************************************************/
+void
+FastaStream :: seek(size_t offset)
+{
+	input.seek(offset);
+	begin = end = 0;
+	buffer_pos = offset;
+	eof = has_header = false;
+}
+
+size_t
+FastaStream :: nextOffset() const
+{
+	return has_header ? header_pos : buffer_pos + end;
+}
+
+/**************************************************************
+ * tell() returns the number of bytes already read (of the
+ * compressed file, blocks decompressed in advance included),
+ * getSize() returns the size of the file (0 if not a file)
+ **************************************************************/
+size_t
+FastaStream :: tell() const
+{
+	return input.isCompressed() ? input.getRawRead() : buffer_pos + begin;
+}
+
+size_t
+FastaStream :: getSize() const
+{
+	return input.getRawSize();
+}
+
+/**************************************************************
+ * getLine(line, line_end) gives the next line of the file 
+ * (without '\n'). The line is valid until the next call.
+ * Returns false at the end of the file.
+ **************************************************************/
+bool
+FastaStream :: getLine(const char * & line, const char * & line_end)
+{
+	size_t scanned = begin;
+	for (;;){
+		const char * nl = (const char *) memchr(&buffer[0] + scanned, '\n', end - scanned);
+		if (nl != NULL || (eof && begin < end)){
+			line = &buffer[0] + begin;
+			line_end = (nl != NULL) ? nl : &buffer[0] + end;
+			begin = (line_end - &buffer[0]) + (nl != NULL);
+			return true;
+		}
+		if (eof){
+			return false;
+		}
+		/* Move the incomplete line at the beginning and fill the buffer */
+		memmove(&buffer[0], &buffer[0] + begin, end - begin);
+		buffer_pos += begin;
+		end -= begin;
+		scanned = end;
+		begin = 0;
+		if (end == buffer.size()){
+			buffer.resize(2 * buffer.size());
+		}
+		size_t nread = input.read(&buffer[0] + end, buffer.size() - end);
+		end += nread;
+		if (nread == 0){
+			eof = true;
+		}
+	}
+}
+
+/**************************************************************
+ * nextRecord(name, residues) reads the next record of the
+ * file, lines before the first header are ignored.
+ * Returns false if there is no more record.
+ * A Stockholm file, seen from its first line, is an error.
+ **************************************************************/
+bool
+FastaStream :: nextRecord(string & name, vector<uint8_t> & residues)
+{
+	const char * line;
+	const char * line_end;
+	while (!has_header){
+		if (!getLine(line, line_end)){
+			return false;
+		}
+		if (line < line_end && *line == '>'){
+			const char * p = line + 1;
+			while (p < line_end && *p != ' ' && *p != '\r'){
+				p++;
+			}
+			header.assign(line + 1, p);
+			header_pos = buffer_pos + (line - &buffer[0]);
+			has_header = true;
+		} else if (line_end - line >= 11 && strncmp(line, "# STOCKHOLM", 11) == 0){
+			cerr << "error : the stream mode (-S) reads fasta or a2m/a3m files, not Stockholm files\n";
+			exit(0);
+		}
+	}
+	name = header;
+	has_header = false;
+	residues.clear();
+	while (getLine(line, line_end)){
+		if (line < line_end && *line == '>'){
+			const char * p = line + 1;
+			while (p < line_end && *p != ' ' && *p != '\r'){
+				p++;
+			}
+			header.assign(line + 1, p);
+			header_pos = buffer_pos + (line - &buffer[0]);
+			has_header = true;
+			break;
+		}
+		for (; line < line_end; ++line){
+			if (a3m && (*line == '.' || islower((unsigned char) *line))){
+				continue;
+			}
+			if (*line != '\r'){
+				residues.push_back((uint8_t) toupper((unsigned char) *line));
+			}
+		}
+	}
+	return true;
+}
@@ -0,0 +1,86 @@
+/* Copyright (c) 2012 Guillaume Collet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __FASTA_H__
+#define __FASTA_H__
+
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstddef>
+#include <stdint.h>
+
+#include "input.h"
+
+using namespace std;
+
+/* A record of a multi-fasta file, pointing in the file content */
+struct FastaRecord
+{
+	const char * name;     /**< First character of the name (after '>') */
+	const char * name_end; /**< End of the name (first space or end of line) */
+	const char * seq;      /**< First character of the sequence lines */
+	const char * seq_end;  /**< End of the sequence lines (next '>' or end of file) */
+	
+	string getName() const {return string(name, name_end);};
+	int countResidues() const;              /**< Number of residues (end of lines excluded) */
+	int decodeResidues(uint8_t * out, int max_size) const;	/**< Copies the residues in upper case, returns their number */
+};
+
+/* Find the records of a multi-fasta content, at most max_seq (all if max_seq < 0) */
+void indexFasta(const char * data, size_t size, int max_seq, vector<FastaRecord> & records);
+
+/*
+ * FastaStream reads a multi-fasta file record by record through a
+ * fixed size buffer, so the memory used does not depend on the size
+ * of the file. The file may be compressed (see InputStream), an
+ * a2m/a3m file is read without its insertions.
+ */
+class FastaStream
+{
+protected:
+	InputStream input;
+	bool   a3m;            /**< True to remove the insertions (lower case and '.') of an a2m/a3m file */
+	vector<char> buffer;   /**< Buffer of the file content */
+	size_t begin;          /**< First unread byte of buffer */
+	size_t end;            /**< End of the valid bytes of buffer */
+	bool   eof;            /**< True when the whole file is in buffer */
+	bool   has_header;     /**< True if the header of the next record is already read */
+	size_t buffer_pos;     /**< Offset in the file of the first byte of buffer */
+	size_t header_pos;     /**< Offset in the file of the header of the next record */
+	string header;         /**< Name of the next record */
+	
+	bool getLine(const char * & line, const char * & line_end);	/**< Reads the next line of the file */
+	
+public:
+	FastaStream(string fname);
+	~FastaStream();
+	void rewind();                                            /**< Goes back to the first record */
+	void seek(size_t offset);                                 /**< Goes to the record starting at offset */
+	size_t nextOffset() const;                                /**< Offset of the next record (end of the file read if none) */
+	size_t tell() const;                                      /**< Number of bytes of the file already read */
+	size_t getSize() const;                                   /**< Number of bytes of the file (0 if unknown) */
+	bool isCompressed() const {return input.isCompressed();}; /**< True if the file is compressed (seek only to 0) */
+	bool isRegular() const {return input.isRegular();};       /**< True if the file can be read again (not a pipe) */
+	bool nextRecord(string & name, vector<uint8_t> & residues);	/**< Reads the next record, residues in upper case */
+};
+
+#endif
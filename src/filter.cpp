@@ -0,0 +1,169 @@
+/* Copyright (c) 2012 Guillaume Collet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "filter.h"
+#include "kernels.h"
+#include "parallel.h"
+#include "profile.h"
+#include "arena.h"
+
+#include <algorithm>
+#include <iostream>
+#include <cstdlib>
+
+#define FILTER_BLOCK 256
+#define GAP_CODE 255
+
+using namespace std;
+
+/*
+ * The sequences of the filter, row by row : the position in alphabet of
+ * each residue (GAP_CODE for all the gaps and the padding up to a multiple
+ * of 32 columns), and a bit per column set for the gaps.
+ */
+struct IdentityRows
+{
+	int size;									/**< Number of columns, padding included */
+	int nword;								/**< Number of 64 bits words of the gaps of a sequence */
+	vector<uint8_t>  codes;		/**< Symbols of sequence r at r * size */
+	vector<uint64_t> gaps;		/**< Gaps of sequence r at r * nword */
+	
+	/* True if the identity of the sequences r and s is more than max_id */
+	bool similar(int r, int s, float max_id) const
+	{
+		int equal = countEqual(&codes[(size_t) r * size], &codes[(size_t) s * size], size);
+		const uint64_t * g = &gaps[(size_t) r * nword];
+		const uint64_t * h = &gaps[(size_t) s * nword];
+		int both = 0;
+		int any = 0;
+		for (int w(0); w < nword; ++w){
+			both += __builtin_popcountll(g[w] & h[w]);
+			any  += __builtin_popcountll(g[w] | h[w]);
+		}
+		int aligned = size - any;
+		return aligned > 0 && (double) (equal - both) > (double) max_id * aligned;
+	}
+};
+
+/**************************************************************
+ * fillRows(msa, rows, first, last, out) writes the sequences
+ * rows of msa, columns [first, last[, row by row in out.
+ **************************************************************/
+static void
+fillRows(const Msa & msa, const vector<int> & rows, int first, int last, IdentityRows & out)
+{
+	int n = (int) rows.size();
+	int K = (int) msa.getAlphabet().size();
+	out.size = ((last - first + 31) / 32) * 32;
+	out.nword = (out.size + 63) / 64;
+	out.codes.assign((size_t) n * out.size, GAP_CODE);
+	out.gaps.assign((size_t) n * out.nword, 0);
+	uint8_t code[256];
+	for (int a(0); a < K; ++a){
+		code[a] = msa.isGap(a) ? GAP_CODE : (uint8_t) a;
+	}
+	/* The padding columns are gaps */
+	for (int r(0); r < n; ++r){
+		for (int x(last - first); x < out.size; ++x){
+			out.gaps[(size_t) r * out.nword + x / 64] |= 1ULL << (x % 64);
+		}
+	}
+	/* Each thread writes the columns of a range of words of the gaps */
+	parallelFor(0, out.nword, [&](int wbegin, int wend){
+		Scratch scratch;
+		uint8_t * buf = msa.isPacked() ? scratch.get<uint8_t>(((size_t) msa.getNseq() + 63) / 64 * 64) : NULL;
+		for (int x(wbegin * 64); x < min(wend * 64, last - first); ++x){
+			const uint8_t * column = msa.getColumn(first + x, buf);
+			for (int r(0); r < n; ++r){
+				uint8_t c = code[column[rows[r]]];
+				out.codes[(size_t) r * out.size + x] = c;
+				if (c == GAP_CODE){
+					out.gaps[(size_t) r * out.nword + x / 64] |= 1ULL << (x % 64);
+				}
+			}
+		}
+	});
+}
+
+vector<int>
+filterIdentity(const Msa & msa, const vector<int> & rows, int first, int last, float max_id)
+{
+	ScopedTimer timer("filter");
+	if (msa.isStreamed()){
+		cerr << "error : no identity filter of an alignment read in stream mode\n";
+		exit(0);
+	}
+	/* An alignment without columns only has the empty range [0, 0[ */
+	if (first < 0 || last > msa.getNcol() || (first >= last && !(first == 0 && last == 0))){
+		cerr << "error : the columns " << first + 1 << "-" << last << " are not in the alignment (" << msa.getNcol() << " columns)\n";
+		exit(0);
+	}
+	for (int r(0); r < (int) rows.size(); ++r){
+		if (rows[r] < 0 || rows[r] >= msa.getNseq()){
+			cerr << "error : the sequence " << rows[r] + 1 << " is not in the alignment (" << msa.getNseq() << " sequences)\n";
+			exit(0);
+		}
+	}
+	vector<int> candidates = rows;
+	if (candidates.empty()){
+		for (int r(0); r < msa.getNseq(); ++r){
+			candidates.push_back(r);
+		}
+	}
+	if (first == last){
+		/* No column to compare, all the sequences are kept */
+		return candidates;
+	}
+	IdentityRows seqs;
+	fillRows(msa, candidates, first, last, seqs);
+	
+	/* Greedy clustering : the candidates of a block are first compared to
+	 * the sequences kept before the block (in parallel), then the ones left
+	 * are compared in order to those kept in the block */
+	int n = (int) candidates.size();
+	vector<int> kept;
+	vector<uint8_t> removed(FILTER_BLOCK);
+	for (int b(0); b < n; b += FILTER_BLOCK){
+		int size = min(FILTER_BLOCK, n - b);
+		int nkept = (int) kept.size();
+		parallelFor(0, size, [&](int begin, int end){
+			for (int c(begin); c < end; ++c){
+				removed[c] = 0;
+				for (int k(0); k < nkept && !removed[c]; ++k){
+					removed[c] = seqs.similar(b + c, kept[k], max_id);
+				}
+			}
+		}, 1);
+		for (int c(0); c < size; ++c){
+			bool redundant = removed[c];
+			for (int k(nkept); k < (int) kept.size() && !redundant; ++k){
+				redundant = seqs.similar(b + c, kept[k], max_id);
+			}
+			if (!redundant){
+				kept.push_back(b + c);
+			}
+		}
+	}
+	for (int k(0); k < (int) kept.size(); ++k){
+		kept[k] = candidates[kept[k]];
+	}
+	return kept;
+}
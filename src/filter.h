@@ -0,0 +1,45 @@
+/* Copyright (c) 2012 Guillaume Collet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __FILTER_H__
+#define __FILTER_H__
+
+#include <vector>
+
+#include "msa.h"
+
+using namespace std;
+
+/*
+ * filterIdentity(msa, rows, first, last, max_id) keeps representative
+ * sequences of rows (all the sequences if empty) : in their order, a
+ * sequence is kept if its identity with each sequence kept before is
+ * at most max_id. The identity of two sequences is the fraction of
+ * identical residues among the columns [first, last[ where none of
+ * them has a gap. Returns the sequences kept (numbers in msa), to be
+ * given to the view Msa(msa, kept, first, last).
+ * The candidates are compared by blocks to the sequences kept, by the
+ * threads, so the result is the one of the sequential greedy
+ * clustering whatever the number of threads.
+ */
+vector<int> filterIdentity(const Msa & msa, const vector<int> & rows, int first, int last, float max_id);
+
+#endif
@@ -20,7 +20,8 @@
  */
 
 #include "gap.h"
-#include "options.h"
+#include "context.h"
+#include "parallel.h"
 
 #include <fstream>
 
@@ -29,7 +30,10 @@ GapStat :: calculate(Msa & msa)
 {
 	int L = msa.getNcol();
 	int N = msa.getNseq();
-	for (int x(0); x < L; ++x){
-		col_stat.push_back((float) msa.getGap(x) / (float) N);
-	}
+	col_stat.assign(L, 0.0);
+	parallelFor(0, L, [&](int first, int last){
+		for (int x(first); x < last; ++x){
+			col_stat[x] = (float) msa.getGap(x) / (float) N;
+		}
+	});
 }
@@ -0,0 +1,636 @@
+/* Copyright (c) 2012 Guillaume Collet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "input.h"
+#include "parallel.h"
+#include "profile.h"
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <map>
+#include <sys/stat.h>
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#define INPUT_BLOCK (1 << 20)
+#define INPUT_QUEUE 4
+
+using namespace std;
+
+
+/**************************************************************
+ * detectCompression(data, size) finds the compression from the
+ * magic number of the first bytes of a file.
+ **************************************************************/
+Compression
+detectCompression(const char * data, size_t size)
+{
+	const unsigned char * p = (const unsigned char *) data;
+	if (size >= 2 && p[0] == 0x1f && p[1] == 0x8b){
+		return GZIP_COMPRESSION;
+	}
+	if (size >= 4 && p[0] == 0x28 && p[1] == 0xb5 && p[2] == 0x2f && p[3] == 0xfd){
+		return ZSTD_COMPRESSION;
+	}
+	return NO_COMPRESSION;
+}
+
+/**************************************************************
+ * detectFormat(fname, data, size) finds the format from the
+ * extension of fname (after .gz or .zst), .a2m/.a3m or
+ * .sto/.stk/.sth, otherwise a content beginning by
+ * "# STOCKHOLM" is a Stockholm alignment, and others are fasta.
+ **************************************************************/
+AlignmentFormat
+detectFormat(const string & fname, const char * data, size_t size)
+{
+	string name = fname;
+	for (size_t i(0); i < name.size(); ++i){
+		name[i] = (char) tolower((unsigned char) name[i]);
+	}
+	const char * packed[3] = {".gz", ".zst", ".zstd"};
+	for (int i(0); i < 3; ++i){
+		size_t len = strlen(packed[i]);
+		if (name.size() > len && name.compare(name.size() - len, len, packed[i]) == 0){
+			name.erase(name.size() - len);
+			break;
+		}
+	}
+	size_t dot = name.find_last_of("./");
+	string ext = (dot != string::npos && name[dot] == '.') ? name.substr(dot + 1) : "";
+	if (ext == "a2m" || ext == "a3m"){
+		return A3M_FORMAT;
+	}
+	if (ext == "sto" || ext == "stk" || ext == "sth" || ext == "stockholm"){
+		return STOCKHOLM_FORMAT;
+	}
+	size_t p = 0;
+	while (p < size && isspace((unsigned char) data[p])){
+		p++;
+	}
+	if (size - p >= 11 && strncmp(data + p, "# STOCKHOLM", 11) == 0){
+		return STOCKHOLM_FORMAT;
+	}
+	return FASTA_FORMAT;
+}
+
+
+/** Constructor from a filename fname, the producer starts at once */
+InputStream :: InputStream(const string & fname) : type(NO_COMPRESSION), file(NULL), gz(NULL), zstd(NULL), in_pos(0), in_end(0), raw_size(0), regular(false), raw_read(0), blocks(INPUT_QUEUE, vector<char>(INPUT_BLOCK)), filled(INPUT_QUEUE, 0), head(0), count(0), head_pos(0), finished(false), stop(false)
+{
+	file = fopen(fname.c_str(), "rb");
+	if (file == NULL){
+		cerr << "Cannot open file " << fname << "\n";
+		exit(0);
+	}
+	struct stat info;
+	if (fstat(fileno(file), &info) == 0 && S_ISREG(info.st_mode)){
+		raw_size = (size_t) info.st_size;
+		regular = true;
+	}
+	/* The first bytes give the compression, a pipe cannot go back so they are kept */
+	in.resize(1 << 17);
+	in_end = fread(&in[0], 1, 4, file);
+	raw_read = in_end;
+	type = detectCompression(&in[0], in_end);
+	if (type == NO_COMPRESSION){
+		memcpy(&blocks[0][0], &in[0], in_end);
+		filled[0] = in_end;
+		count = in_end ? 1 : 0;
+		in.clear();
+		in_end = 0;
+	} else if (type == GZIP_COMPRESSION){
+		z_stream * strm = new z_stream;
+		memset(strm, 0, sizeof(z_stream));
+		inflateInit2(strm, 15 + 16);
+		gz = strm;
+	} else {
+#ifdef HAVE_ZSTD
+		zstd = ZSTD_createDCtx();
+		in.resize(max(in.size(), ZSTD_DStreamInSize()));
+#else
+		cerr << fname << " is compressed by zstd, mstatx must be built with zstd (make ZSTD=1)\n";
+		exit(0);
+#endif
+	}
+	start();
+}
+
+/* Destructor */
+InputStream :: ~InputStream()
+{
+	finish();
+	fclose(file);
+	if (gz != NULL){
+		inflateEnd((z_stream *) gz);
+		delete (z_stream *) gz;
+	}
+#ifdef HAVE_ZSTD
+	if (zstd != NULL){
+		ZSTD_freeDCtx((ZSTD_DCtx *) zstd);
+	}
+#endif
+}
+
+/**************************************************************
+ * decode(out, size) fills out with the next decompressed bytes
+ * of the file, returns their number (less than size at the end)
+ * The members of a gzip file (and the frames of a zstd file)
+ * are decompressed one after the other.
+ **************************************************************/
+size_t
+InputStream :: decode(char * out, size_t size)
+{
+	if (type == NO_COMPRESSION){
+		size_t done = fread(out, 1, size, file);
+		raw_read += done;
+		return done;
+	}
+	size_t done = 0;
+	while (done < size){
+		if (in_pos == in_end){
+			in_end = fread(&in[0], 1, in.size(), file);
+			in_pos = 0;
+			raw_read += in_end;
+			if (in_end == 0){
+				if (type == GZIP_COMPRESSION && ((z_stream *) gz)->total_in != 0){
+					cerr << "error : the gzip input is truncated\n";
+					exit(0);
+				}
+				break;
+			}
+		}
+		if (type == GZIP_COMPRESSION){
+			z_stream * strm = (z_stream *) gz;
+			strm->next_in = (Bytef *) &in[in_pos];
+			strm->avail_in = (uInt) (in_end - in_pos);
+			strm->next_out = (Bytef *) out + done;
+			strm->avail_out = (uInt) (size - done);
+			int ret = inflate(strm, Z_NO_FLUSH);
+			if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR){
+				cerr << "error : the gzip input is not valid (" << (strm->msg ? strm->msg : "inflate") << ")\n";
+				exit(0);
+			}
+			in_pos = in_end - strm->avail_in;
+			done = size - strm->avail_out;
+			if (ret == Z_STREAM_END){
+				/* Another member may follow */
+				inflateReset(strm);
+			}
+		}
+#ifdef HAVE_ZSTD
+		else {
+			ZSTD_outBuffer output = {out + done, size - done, 0};
+			ZSTD_inBuffer input = {&in[0], in_end, in_pos};
+			size_t ret = ZSTD_decompressStream((ZSTD_DCtx *) zstd, &output, &input);
+			if (ZSTD_isError(ret)){
+				cerr << "error : the zstd input is not valid (" << ZSTD_getErrorName(ret) << ")\n";
+				exit(0);
+			}
+			in_pos = input.pos;
+			done += output.pos;
+		}
+#endif
+	}
+	return done;
+}
+
+/**************************************************************
+ * produce() decompresses the file block by block in the ring,
+ * waiting while all the blocks are ready and not read.
+ **************************************************************/
+void
+InputStream :: produce()
+{
+	for (;;){
+		unique_lock<mutex> guard(lock);
+		changed.wait(guard, [&](){return stop || count < INPUT_QUEUE;});
+		if (stop){
+			return;
+		}
+		int slot = (head + count) % INPUT_QUEUE;
+		guard.unlock();
+		size_t n = decode(&blocks[slot][0], INPUT_BLOCK);
+		guard.lock();
+		filled[slot] = n;
+		if (n > 0){
+			count++;
+		}
+		if (n < INPUT_BLOCK){
+			finished = true;
+		}
+		changed.notify_all();
+		if (finished){
+			return;
+		}
+	}
+}
+
+void
+InputStream :: start()
+{
+	stop = finished = false;
+	producer = thread([this](){produce();});
+}
+
+void
+InputStream :: finish()
+{
+	{
+		lock_guard<mutex> guard(lock);
+		stop = true;
+	}
+	changed.notify_all();
+	if (producer.joinable()){
+		producer.join();
+	}
+}
+
+/**************************************************************
+ * read(data, size) copies the next decompressed bytes in data,
+ * waiting for the producer if no block is ready.
+ **************************************************************/
+size_t
+InputStream :: read(char * data, size_t size)
+{
+	size_t done = 0;
+	while (done < size){
+		unique_lock<mutex> guard(lock);
+		changed.wait(guard, [&](){return count > 0 || finished;});
+		if (count == 0){
+			break;
+		}
+		guard.unlock();
+		size_t n = min(size - done, filled[head] - head_pos);
+		memcpy(data + done, &blocks[head][head_pos], n);
+		head_pos += n;
+		done += n;
+		if (head_pos == filled[head]){
+			guard.lock();
+			head = (head + 1) % INPUT_QUEUE;
+			count--;
+			head_pos = 0;
+			changed.notify_all();
+		}
+	}
+	return done;
+}
+
+/**************************************************************
+ * seek(offset) goes to offset in the decompressed content.
+ * Compressed files can only go back to their beginning.
+ **************************************************************/
+void
+InputStream :: seek(size_t offset)
+{
+	finish();
+	head = count = 0;
+	head_pos = 0;
+	if (offset != 0 && type != NO_COMPRESSION){
+		cerr << "error : a compressed file can only be read again from its beginning\n";
+		exit(0);
+	}
+	if (fseek(file, (long) offset, SEEK_SET) != 0){
+		cerr << "error : cannot go back in the input (pipe)\n";
+		exit(0);
+	}
+	raw_read = offset;
+	in_pos = in_end = 0;
+	if (type == GZIP_COMPRESSION){
+		inflateReset((z_stream *) gz);
+	}
+#ifdef HAVE_ZSTD
+	if (type == ZSTD_COMPRESSION){
+		ZSTD_DCtx_reset((ZSTD_DCtx *) zstd, ZSTD_reset_session_only);
+	}
+#endif
+	start();
+}
+
+
+/* A block of a BGZF file: position and size in the file, position and size of its content */
+struct GzipBlock
+{
+	size_t pos;
+	size_t size;
+	size_t out_pos;
+	size_t out_size;
+};
+
+/**************************************************************
+ * bgzfBlocks(data, size, blocks) lists the blocks of a BGZF
+ * file (gzip members with their size in the 'BC' extra field,
+ * as written by bgzip). Returns false for other gzip files.
+ **************************************************************/
+static bool
+bgzfBlocks(const char * data, size_t size, vector<GzipBlock> & blocks)
+{
+	const unsigned char * p = (const unsigned char *) data;
+	size_t pos = 0;
+	size_t out_pos = 0;
+	while (pos < size){
+		if (size - pos < 18 || p[pos] != 0x1f || p[pos + 1] != 0x8b || p[pos + 3] != 4){
+			return false;
+		}
+		size_t xlen = p[pos + 10] | (size_t) p[pos + 11] << 8;
+		if (xlen < 6 || p[pos + 12] != 'B' || p[pos + 13] != 'C' || p[pos + 14] != 2 || p[pos + 15] != 0){
+			return false;
+		}
+		GzipBlock block;
+		block.pos = pos;
+		block.size = (p[pos + 16] | (size_t) p[pos + 17] << 8) + 1;
+		if (block.size < 12 + xlen + 8 || block.size > size - pos){
+			return false;
+		}
+		const unsigned char * tail = p + pos + block.size - 4;
+		block.out_pos = out_pos;
+		block.out_size = tail[0] | (size_t) tail[1] << 8 | (size_t) tail[2] << 16 | (size_t) tail[3] << 24;
+		blocks.push_back(block);
+		out_pos += block.out_size;
+		pos += block.size;
+	}
+	return blocks.size() > 1;
+}
+
+/* Inflates the raw deflate data of a BGZF block and checks its CRC */
+static bool
+inflateBlock(const unsigned char * block, size_t size, char * out, size_t out_size)
+{
+	size_t xlen = block[10] | (size_t) block[11] << 8;
+	z_stream strm;
+	memset(&strm, 0, sizeof(strm));
+	if (inflateInit2(&strm, -15) != Z_OK){
+		return false;
+	}
+	strm.next_in = (Bytef *) block + 12 + xlen;
+	strm.avail_in = (uInt) (size - 12 - xlen - 8);
+	strm.next_out = (Bytef *) out;
+	strm.avail_out = (uInt) out_size;
+	int ret = inflate(&strm, Z_FINISH);
+	inflateEnd(&strm);
+	const unsigned char * tail = block + size - 8;
+	uLong crc = tail[0] | (uLong) tail[1] << 8 | (uLong) tail[2] << 16 | (uLong) tail[3] << 24;
+	return ret == Z_STREAM_END && strm.avail_out == 0 && crc32(crc32(0L, Z_NULL, 0), (const Bytef *) out, (uInt) out_size) == crc;
+}
+
+/* Decompresses gzip members one after the other */
+static bool
+inflateMembers(const char * data, size_t size, string & out)
+{
+	z_stream strm;
+	memset(&strm, 0, sizeof(strm));
+	if (inflateInit2(&strm, 15 + 16) != Z_OK){
+		return false;
+	}
+	vector<char> buf(INPUT_BLOCK);
+	strm.next_in = (Bytef *) data;
+	strm.avail_in = (uInt) size;
+	int ret = Z_OK;
+	for (;;){
+		strm.next_out = (Bytef *) &buf[0];
+		strm.avail_out = (uInt) buf.size();
+		ret = inflate(&strm, Z_NO_FLUSH);
+		out.append(&buf[0], buf.size() - strm.avail_out);
+		if (ret == Z_STREAM_END){
+			/* Another member may follow */
+			if (strm.avail_in >= 2 && strm.next_in[0] == 0x1f && strm.next_in[1] == 0x8b){
+				inflateReset(&strm);
+				continue;
+			}
+			break;
+		}
+		if (ret != Z_OK){
+			break;
+		}
+	}
+	inflateEnd(&strm);
+	return ret == Z_STREAM_END;
+}
+
+/**************************************************************
+ * decompressAll(fname, data, size, type, out) decompresses the
+ * whole content. The blocks of BGZF files (bgzip) and the
+ * frames of zstd files with their content size (zstd -T,
+ * pzstd) are independent and decompressed by the threads,
+ * other files can only be decompressed in sequence.
+ **************************************************************/
+void
+decompressAll(const string & fname, const char * data, size_t size, Compression type, string & out)
+{
+	ScopedTimer timer("decompress");
+	out.clear();
+	if (type == GZIP_COMPRESSION){
+		vector<GzipBlock> blocks;
+		if (bgzfBlocks(data, size, blocks)){
+			out.resize(blocks.back().out_pos + blocks.back().out_size);
+			atomic<bool> ok(true);
+			parallelFor(0, (int) blocks.size(), [&](int first, int last){
+				for (int b(first); b < last; ++b){
+					if (!inflateBlock((const unsigned char *) data + blocks[b].pos, blocks[b].size, &out[blocks[b].out_pos], blocks[b].out_size)){
+						ok = false;
+					}
+				}
+			});
+			if (ok){
+				return;
+			}
+			out.clear();
+		}
+		if (!inflateMembers(data, size, out)){
+			cerr << "error : " << fname << " is not a valid gzip file\n";
+			exit(0);
+		}
+		return;
+	}
+	if (type == ZSTD_COMPRESSION){
+#ifdef HAVE_ZSTD
+		vector<GzipBlock> frames;
+		bool known = true;
+		size_t total = 0;
+		for (size_t pos(0); pos < size; ){
+			GzipBlock frame;
+			frame.pos = pos;
+			frame.size = ZSTD_findFrameCompressedSize(data + pos, size - pos);
+			if (ZSTD_isError(frame.size)){
+				cerr << "error : " << fname << " is not a valid zstd file (" << ZSTD_getErrorName(frame.size) << ")\n";
+				exit(0);
+			}
+			unsigned long long content = ZSTD_getFrameContentSize(data + pos, frame.size);
+			known = known && content != ZSTD_CONTENTSIZE_UNKNOWN && content != ZSTD_CONTENTSIZE_ERROR;
+			frame.out_pos = total;
+			frame.out_size = known ? (size_t) content : 0;
+			total += frame.out_size;
+			frames.push_back(frame);
+			pos += frame.size;
+		}
+		if (known && frames.size() > 1){
+			out.resize(total);
+			atomic<bool> ok(true);
+			parallelFor(0, (int) frames.size(), [&](int first, int last){
+				ZSTD_DCtx * ctx = ZSTD_createDCtx();
+				for (int f(first); f < last; ++f){
+					size_t ret = ZSTD_decompressDCtx(ctx, &out[frames[f].out_pos], frames[f].out_size, data + frames[f].pos, frames[f].size);
+					if (ZSTD_isError(ret) || ret != frames[f].out_size){
+						ok = false;
+					}
+				}
+				ZSTD_freeDCtx(ctx);
+			});
+			if (!ok){
+				cerr << "error : " << fname << " is not a valid zstd file\n";
+				exit(0);
+			}
+			return;
+		}
+		ZSTD_DCtx * ctx = ZSTD_createDCtx();
+		vector<char> buf(ZSTD_DStreamOutSize());
+		ZSTD_inBuffer input = {data, size, 0};
+		while (input.pos < input.size){
+			ZSTD_outBuffer output = {&buf[0], buf.size(), 0};
+			size_t ret = ZSTD_decompressStream(ctx, &output, &input);
+			if (ZSTD_isError(ret)){
+				cerr << "error : " << fname << " is not a valid zstd file (" << ZSTD_getErrorName(ret) << ")\n";
+				exit(0);
+			}
+			out.append(&buf[0], output.pos);
+		}
+		ZSTD_freeDCtx(ctx);
+		return;
+#else
+		cerr << fname << " is compressed by zstd, mstatx must be built with zstd (make ZSTD=1)\n";
+		exit(0);
+#endif
+	}
+	out.assign(data, size);
+}
+
+
+/**************************************************************
+ * a3mToFasta(data, size, fasta) copies the headers and keeps
+ * the residues of the match states: upper case, '-' and the
+ * other symbols but lower case letters and '.'.
+ **************************************************************/
+void
+a3mToFasta(const char * data, size_t size, string & fasta)
+{
+	fasta.clear();
+	fasta.reserve(size);
+	const char * end = data + size;
+	for (const char * p(data); p < end; ){
+		const char * eol = (const char *) memchr(p, '\n', end - p);
+		if (eol == NULL){
+			eol = end;
+		}
+		if (*p == '>'){
+			fasta.append(p, eol);
+		} else {
+			for (const char * c(p); c < eol; ++c){
+				if (*c != '.' && !islower((unsigned char) *c)){
+					fasta.push_back(*c);
+				}
+			}
+		}
+		fasta.push_back('\n');
+		p = eol + 1;
+	}
+}
+
+/**************************************************************
+ * stockholmToFasta(data, size, fasta) joins the sequence lines
+ * "name residues" of each name in the order of the first
+ * appearance of the names. The lines beginning by '#' (header
+ * and annotations) are ignored, "//" ends the alignment.
+ **************************************************************/
+void
+stockholmToFasta(const char * data, size_t size, string & fasta)
+{
+	vector<string> names;
+	vector<string> seqs;
+	map<string, int> index;
+	const char * end = data + size;
+	for (const char * p(data); p < end; ){
+		const char * eol = (const char *) memchr(p, '\n', end - p);
+		if (eol == NULL){
+			eol = end;
+		}
+		const char * line_end = (eol > p && eol[-1] == '\r') ? eol - 1 : eol;
+		const char * q = p;
+		while (q < line_end && (*q == ' ' || *q == '\t')){
+			q++;
+		}
+		if (line_end - q >= 2 && q[0] == '/' && q[1] == '/'){
+			break;
+		}
+		if (q < line_end && *q != '#'){
+			const char * name_end = q;
+			while (name_end < line_end && *name_end != ' ' && *name_end != '\t'){
+				name_end++;
+			}
+			string name(q, name_end);
+			map<string, int>::iterator it = index.find(name);
+			if (it == index.end()){
+				it = index.insert(make_pair(name, (int) names.size())).first;
+				names.push_back(name);
+				seqs.push_back(string());
+			}
+			string & seq = seqs[it->second];
+			for (const char * c(name_end); c < line_end; ++c){
+				if (*c != ' ' && *c != '\t'){
+					seq.push_back(*c == '.' ? '-' : *c);
+				}
+			}
+		}
+		p = eol + 1;
+	}
+	fasta.clear();
+	for (size_t i(0); i < names.size(); ++i){
+		fasta += ">" + names[i] + "\n" + seqs[i] + "\n";
+	}
+}
+
+bool
+loadAlignment(const string & fname, const char * data, size_t size, string & fasta)
+{
+	Compression type = detectCompression(data, size);
+	string content;
+	if (type != NO_COMPRESSION){
+		decompressAll(fname, data, size, type, content);
+		data = content.data();
+		size = content.size();
+	}
+	AlignmentFormat format = detectFormat(fname, data, size);
+	if (format == FASTA_FORMAT && type == NO_COMPRESSION){
+		return false;
+	}
+	ScopedTimer timer("convert");
+	if (format == A3M_FORMAT){
+		a3mToFasta(data, size, fasta);
+	} else if (format == STOCKHOLM_FORMAT){
+		stockholmToFasta(data, size, fasta);
+	} else {
+		fasta.swap(content);
+	}
+	return true;
+}
@@ -0,0 +1,115 @@
+/* Copyright (c) 2012 Guillaume Collet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __INPUT_H__
+#define __INPUT_H__
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <cstdio>
+#include <cstddef>
+#include <condition_variable>
+
+using namespace std;
+
+/* Compression of a file, found from its first bytes */
+enum Compression {NO_COMPRESSION, GZIP_COMPRESSION, ZSTD_COMPRESSION};
+
+/* Format of an alignment, found from the name of the file and its content */
+enum AlignmentFormat {FASTA_FORMAT, A3M_FORMAT, STOCKHOLM_FORMAT};
+
+Compression detectCompression(const char * data, size_t size);
+AlignmentFormat detectFormat(const string & fname, const char * data, size_t size);
+
+/*
+ * InputStream reads a file, plain or compressed by gzip (zlib) or
+ * zstd (if built with HAVE_ZSTD), as a stream of decompressed bytes.
+ * The file is read and decompressed by a thread of its own, a few
+ * blocks ahead of read(), so the decompression overlaps the parsing
+ * of the records.
+ */
+class InputStream
+{
+private:
+	Compression type;
+	FILE * file;
+	void * gz;									/**< The z_stream of zlib (gzip) */
+	void * zstd;								/**< The ZSTD_DCtx (zstd) */
+	vector<char> in;						/**< Compressed bytes read in advance */
+	size_t in_pos;							/**< First byte of in not decompressed */
+	size_t in_end;							/**< End of the bytes of in */
+	size_t raw_size;						/**< Size of the file */
+	bool   regular;							/**< True for a regular file (not a pipe), which can be read again */
+	atomic<size_t> raw_read;		/**< Bytes of the file read */
+	
+	vector<vector<char> > blocks;	/**< Ring of decompressed blocks */
+	vector<size_t> filled;			/**< Bytes of each block */
+	int    head;								/**< Block read by read() */
+	int    count;								/**< Number of blocks ready from head */
+	size_t head_pos;						/**< Bytes of the head block already read */
+	bool   finished;						/**< True when the producer reached the end of the file */
+	bool   stop;								/**< True to stop the producer */
+	mutex  lock;
+	condition_variable changed;
+	thread producer;
+	
+	size_t decode(char * out, size_t size);	/**< Next decompressed bytes of the file (0 at the end), called by the producer */
+	void   produce();						/**< Fills the ring of blocks until the end of the file */
+	void   start();							/**< Starts the producer */
+	void   finish();						/**< Stops the producer */
+	
+	InputStream(const InputStream &);
+	InputStream & operator=(const InputStream &);
+	
+public:
+	InputStream(const string & fname);
+	~InputStream();
+	size_t read(char * data, size_t size);	/**< Copies at most size decompressed bytes in data, returns their number (0 at the end) */
+	void   seek(size_t offset);			/**< Goes to offset in the decompressed bytes (0 only for a compressed file) */
+	bool   isCompressed() const {return type != NO_COMPRESSION;};
+	size_t getRawSize() const {return raw_size;};	/**< Size of the file */
+	bool   isRegular() const {return regular;};		/**< True if the file can be read again (not a pipe) */
+	size_t getRawRead() const {return raw_read;};	/**< Bytes of the file read (ahead of read() by the blocks in advance) */
+};
+
+/* Decompresses the size bytes of data (e.g. a mapped file) in out; the
+ * blocks of BGZF files and the frames of zstd files are decompressed by
+ * the threads, a single gzip member is decompressed in sequence */
+void decompressAll(const string & fname, const char * data, size_t size, Compression type, string & out);
+
+/* Converts an a2m/a3m alignment in fasta: the insertions (lower case
+ * residues and '.') are removed */
+void a3mToFasta(const char * data, size_t size, string & fasta);
+
+/* Converts a Stockholm alignment in fasta: the sequence lines of each
+ * name are joined in their order, '.' becomes a gap '-' and the
+ * annotations are ignored (only the first alignment is read) */
+void stockholmToFasta(const char * data, size_t size, string & fasta);
+
+/* Gives in fasta the alignment of the file fname whose content is the
+ * size bytes of data, decompressed and converted if needed. Returns
+ * false, without copy, if data is already a plain fasta alignment. */
+bool loadAlignment(const string & fname, const char * data, size_t size, string & fasta);
+
+#endif
@@ -20,10 +20,12 @@
  */
 
 #include "jensen.h"
-#include "options.h"
+#include "context.h"
 #include "scoring_matrix.h"
+#include "parallel.h"
+#include "background.h"
+#include "arena.h"
 
-#include <map>
 #include <cmath>
 #include <fstream>
 #include <algorithm>
@@ -31,39 +33,6 @@
 #define MIN(x,y)  (x < y ? x : y)
 
 
-/** calcSeqWeight(Msa & msa, int i)
- *
- * Calculate the weight of sequence i in the multiple sequence alignment
- * by the formula from Henikoff & Henikoff (1994)
- * w_i = \frac{1}{L}\sum_{x=1}^{L}\frac{1}{k_x n_{x_i}} (LateX code)
- * We use these notations in the code below
- */
-float
-JensenStat :: calcSeqWeight(Msa & msa, int i)
-{
-	int x;                 /**< used to parse msa columns */
-	int seq;               /**< used to parse msa rows */
-	int k;                 /**< number of symbol types in a column */
-	int n;                 /**< number of occurence of aa[i][x] in the full column x */
-	int L = msa.getNcol(); /**< number of columns (length of the alignment) */
-	int N = msa.getNseq(); /**< number of rows (number of sequences in the alignment) */
-	float w;               /**< weight of sequence i */
-	
-	w = 0.0;
-	for	(x = 0; x < L; ++x){
-		k = msa.getNtype(x);
-		n = 0;
-		for(seq = 0; seq < N; ++seq){
-			if (msa.getSymbol(i, x) == msa.getSymbol(seq, x)){
-				n++;
-			}
-		}
-		w += (float) 1 / (float) (n * k);
-	}
-	w /= (float) L;
-	return w ;
-}
-
 /*
  * Calculate statistics based on the measure 
  * proposed by Capra and Singh (2007)
@@ -76,113 +45,56 @@ void
 JensenStat :: calculate(Msa & msa)
 {
 	/* Init size */
-	string alphabet = msa.getAlphabet();
+	const string & alphabet = msa.getAlphabet();
 	int L = msa.getNcol();
 	int N = msa.getNseq();
 	int K = (int) alphabet.size();
 	
-	/* Allocate proba array */
-	float **proba = (float **) calloc(L, sizeof(float*));
-	if (proba == NULL){
-		fprintf(stderr,"Cannot Allocate probability matrix\n");
-		exit(0);
-	}
-	for (int i(0); i < L; i++){
-		proba[i] = (float *) calloc(K, sizeof(float));
-		if (proba[i] == NULL){
-			fprintf(stderr,"Cannot Allocate probability submatrix\n");
-			exit(0);
-		}
-	}
-
-	/* Calculate Sequence Weights */
-	vector<float> w;
-	for (int seq(0); seq < N; ++seq){
-		w.push_back(calcSeqWeight(msa,seq));
-	}
-
-	/* Background distribution of amino acids 
+	/* Background probability of each symbol of the alphabet (0 if unknown)
 	 * These background frequencies are used in sca paper
 	 */
-	map<char,float> q;
-	q['A'] = 0.073;
-	q['C'] = 0.025;
-	q['D'] = 0.050;
-	q['E'] = 0.061;
-	q['F'] = 0.042;
-	q['G'] = 0.072;
-	q['H'] = 0.023;
-	q['I'] = 0.053;
-	q['K'] = 0.064;
-	q['L'] = 0.089;
-	q['M'] = 0.023;
-	q['N'] = 0.043;
-	q['P'] = 0.052;
-	q['Q'] = 0.040;
-	q['R'] = 0.052;
-	q['S'] = 0.073;
-	q['T'] = 0.056;
-	q['V'] = 0.063;
-	q['W'] = 0.013;
-	q['Y'] = 0.033;
+	vector<float> qa(K, 0.0);
+	for (int a(0); a < K; a++){
+		qa[a] = backgroundFreq(alphabet[a]);
+	}
 	
-	/* Calculate aa proba by columns */
+	/* Calculate aa proba and conservation score by columns */
 	float lambda = 0.5;
+	msa.getWeightedCount(0); /* calculated once before sharing columns among threads */
+	col_stat.assign(L, 0.0);
 	
-  for (int x(0); x < L; ++x){
-		int nb_abs = 0;
-		for (int a(0); a < K; a++){
-		  for (int j(0); j < N; ++j){
-				if(msa.getSymbol(j, x) == alphabet[a]){
-					proba[x][a] += w[j];
+	parallelFor(0, L, [&](int first, int last){
+		Scratch scratch;
+		float * proba = scratch.get<float>(K);
+		for (int x(first); x < last; ++x){
+			const float * p = msa.getWeightedCount(x);
+			int nb_abs = 0;
+			for (int a(0); a < K; a++){
+				proba[a] = p[a];
+				if (proba[a] == 0.0){
+					proba[a] = pow(10.0,-6.0);
+					nb_abs++;
 				}
 			}
-			if (proba[x][a] == 0.0){
-				proba[x][a] = pow(10.0,-6.0);
-				nb_abs++;
-			}
-		}
-		/* reduce by the pseudo counts in order to have sum-of-proba = 1 */
-		float pseudo_counts = (float) nb_abs * pow(10.0,-6.0) / (float) (K - nb_abs);
-		for (int a(0); a < K; a++){
-			if (proba[x][a] > pow(10.0,-6.0)){
-				proba[x][a] -= pseudo_counts;
+			/* reduce by the pseudo counts in order to have sum-of-proba = 1 */
+			float pseudo_counts = (float) nb_abs * pow(10.0,-6.0) / (float) (K - nb_abs);
+			for (int a(0); a < K; a++){
+				if (proba[a] > pow(10.0,-6.0)){
+					proba[a] -= pseudo_counts;
+				}
 			}
-		}
-	}
-	
-	/* Calculate conservation score by columns */
-	for (int x(0); x < L; ++x){
-		float score_left = 0.0;
-		float score_right = 0.0;
-		for (int a(0); a < K; a++){
-			char aa = alphabet[a];
-			if (aa != '-' && aa != 'X' && aa != 'Z' && aa != 'B'){
-				score_left  += proba[x][a] * log(proba[x][a] / (lambda * proba[x][a] + (1.0 - lambda) * q[aa]));
-				score_right += q[aa] * log(q[aa] / (lambda * proba[x][a] + (1.0 - lambda) * q[aa]));
+			
+			/* Calculate conservation score */
+			float score_left = 0.0;
+			float score_right = 0.0;
+			for (int a(0); a < K; a++){
+				char aa = alphabet[a];
+				if (aa != '-' && aa != 'X' && aa != 'Z' && aa != 'B'){
+					score_left  += proba[a] * log(proba[a] / (lambda * proba[a] + (1.0 - lambda) * qa[a]));
+					score_right += qa[a] * log(qa[a] / (lambda * proba[a] + (1.0 - lambda) * qa[a]));
+				}
 			}
+			col_stat[x] = (1 - (lambda * score_left + (1.0 - lambda) * score_right)) * (1 - ((float) msa.getGap(x) / (float) N));
 		}
-		col_stat.push_back((1 - (lambda * score_left + (1.0 - lambda) * score_right)) * (1 - ((float) msa.getGap(x) / (float) N)));
-	}
-	
-	/* Add Side columns effect */
-	/*int window = Options::Get().window;
-	for (int x(0); x < L; ++x){
-		float score = col_stat[x];
-		float side_score = 0.0;
-		for (int i(x-1); i >= 0 && i >= x - window; i--) {
-			side_score += col_stat[i];
-		}
-		for (int i(x+1); i < L && i <= x + window; i++) {
-			side_score += col_stat[i];
-		}
-		side_score /= (2 * window);
-		cout << 0.5 * (score + side_score) <<"\n";
-		col_stat[x] = 0.5 * (score + side_score);
-	}*/
-	
-	for (int i(0); i < L; ++i) {
-		free (proba[i]);	
-	}
-	free(proba);
+	});
 }
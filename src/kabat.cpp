@@ -19,8 +19,9 @@
  * THE SOFTWARE. 
  */
 
-#include "options.h"
+#include "context.h"
 #include "kabat.h"
+#include "parallel.h"
 
 #include <cmath>
 #include <fstream>
@@ -33,25 +34,21 @@
 void
 KabatStat :: calculate(Msa & msa)
 {
-	int k;                    // number of amino acid types in a given column
-	int n1;                   // number of occurences of the most represented residue in a column
-	int N = msa.getNseq();    // number of sequences in the msa
+	int K = (int) msa.getAlphabet().size(); // number of symbols in the alphabet of the msa
 	int ncol = msa.getNcol(); // number of columns in the multiple alignment
-	vector<int> naa;
 
-	for (int x(0); x < ncol; ++x){
-		k = msa.getNtype(x);
-  	/* Find the most represented amino acid type (n1) */
-		string aa_type = msa.getTypeList(x);
-		vector<int> nb_aa(aa_type.size(), 0);
-		for (int s(0); s < N; ++s){
-			nb_aa[aa_type.find(msa.getSymbol(s, x))]++;
+	col_stat.assign(ncol, 0.0);
+	parallelFor(0, ncol, [&](int first, int last){
+		for (int x(first); x < last; ++x){
+			int k = msa.getNtype(x); // number of amino acid types in the column
+	  	/* Find the most represented amino acid type (n1) */
+			const int * nb_aa = msa.getCount(x);
+			int n1 = 0;              // number of occurences of the most represented residue in the column
+			for (int i(0); i < K; ++i)
+				if (nb_aa[i] > n1)
+					n1 = nb_aa[i];
+			/* Calculate conservation from Wu & Kabat formula */
+			col_stat[x] = (float)k / (float) n1;
 		}
-		n1 = 0;
-		for (int i(0); i < (int) nb_aa.size(); ++i)
-			if (nb_aa[i] > n1)
-				n1 = nb_aa[i];
-		/* Calculate conservation from Wu & Kabat formula */
-		col_stat.push_back((float)k / (float) n1);
-	}
+	});
 }
@@ -0,0 +1,232 @@
+/* Copyright (c) 2012 Guillaume Collet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "kernels.h"
+
+#include <cmath>
+#include <cstring>
+
+/* Build with -DNO_SIMD_KERNELS to keep only the scalar version */
+#if defined(NO_SIMD_KERNELS)
+#elif defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_AVX2_KERNELS
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define HAVE_NEON_KERNELS
+#endif
+
+
+/**************************************************************
+ * Scalar version
+ * The sum of squares is done in 8 lanes (a % 8) and the lanes
+ * are combined like the horizontal sums of the vector versions
+ **************************************************************/
+static void
+addScaledRowScalar(float * acc, const float * row, float scale, int size)
+{
+	for (int a(0); a < size; ++a){
+		acc[a] += scale * row[a];
+	}
+}
+
+static float
+distanceScalar(const float * x, const float * y, int size)
+{
+	float lane[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+	for (int a(0); a < size; a += 8){
+		for (int l(0); l < 8; ++l){
+			float d = x[a + l] - y[a + l];
+			lane[l] += d * d;
+		}
+	}
+	float s0 = lane[0] + lane[4];
+	float s1 = lane[1] + lane[5];
+	float s2 = lane[2] + lane[6];
+	float s3 = lane[3] + lane[7];
+	return sqrt((s0 + s2) + (s1 + s3));
+}
+
+/* The bytes of x ^ y are compared to 0 by 8 in a 64 bits word */
+static int
+countEqualScalar(const uint8_t * x, const uint8_t * y, int size)
+{
+	const uint64_t low = 0x7f7f7f7f7f7f7f7fULL;
+	int n = 0;
+	for (int a(0); a < size; a += 8){
+		uint64_t u, v;
+		memcpy(&u, x + a, 8);
+		memcpy(&v, y + a, 8);
+		uint64_t t = u ^ v;
+		/* High bit of each byte set if the byte of t is not 0 */
+		uint64_t nonzero = ((t & low) + low) | t;
+		n += 8 - __builtin_popcountll(nonzero & ~low);
+	}
+	return n;
+}
+
+
+#ifdef HAVE_AVX2_KERNELS
+/**************************************************************
+ * AVX2 version (compiled for AVX2, only called if the CPU
+ * supports it)
+ **************************************************************/
+__attribute__((target("avx2"))) static void
+addScaledRowAvx2(float * acc, const float * row, float scale, int size)
+{
+	__m256 s = _mm256_set1_ps(scale);
+	for (int a(0); a < size; a += 8){
+		__m256 v = _mm256_mul_ps(s, _mm256_loadu_ps(row + a));
+		_mm256_storeu_ps(acc + a, _mm256_add_ps(_mm256_loadu_ps(acc + a), v));
+	}
+}
+
+__attribute__((target("avx2"))) static float
+distanceAvx2(const float * x, const float * y, int size)
+{
+	__m256 lane = _mm256_setzero_ps();
+	for (int a(0); a < size; a += 8){
+		__m256 d = _mm256_sub_ps(_mm256_loadu_ps(x + a), _mm256_loadu_ps(y + a));
+		lane = _mm256_add_ps(lane, _mm256_mul_ps(d, d));
+	}
+	__m128 s = _mm_add_ps(_mm256_castps256_ps128(lane), _mm256_extractf128_ps(lane, 1));
+	s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+	s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+	return sqrt(_mm_cvtss_f32(s));
+}
+
+__attribute__((target("avx2,popcnt"))) static int
+countEqualAvx2(const uint8_t * x, const uint8_t * y, int size)
+{
+	int n = 0;
+	for (int a(0); a < size; a += 32){
+		__m256i eq = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *) (x + a)), _mm256_loadu_si256((const __m256i *) (y + a)));
+		n += _mm_popcnt_u32((unsigned) _mm256_movemask_epi8(eq));
+	}
+	return n;
+}
+#endif
+
+
+#ifdef HAVE_NEON_KERNELS
+/**************************************************************
+ * NEON version
+ **************************************************************/
+static void
+addScaledRowNeon(float * acc, const float * row, float scale, int size)
+{
+	float32x4_t s = vdupq_n_f32(scale);
+	for (int a(0); a < size; a += 4){
+		float32x4_t v = vmulq_f32(s, vld1q_f32(row + a));
+		vst1q_f32(acc + a, vaddq_f32(vld1q_f32(acc + a), v));
+	}
+}
+
+static float
+distanceNeon(const float * x, const float * y, int size)
+{
+	float32x4_t lo = vdupq_n_f32(0);
+	float32x4_t hi = vdupq_n_f32(0);
+	for (int a(0); a < size; a += 8){
+		float32x4_t d_lo = vsubq_f32(vld1q_f32(x + a),     vld1q_f32(y + a));
+		float32x4_t d_hi = vsubq_f32(vld1q_f32(x + a + 4), vld1q_f32(y + a + 4));
+		lo = vaddq_f32(lo, vmulq_f32(d_lo, d_lo));
+		hi = vaddq_f32(hi, vmulq_f32(d_hi, d_hi));
+	}
+	float32x4_t s = vaddq_f32(lo, hi);
+	float32x2_t h = vadd_f32(vget_low_f32(s), vget_high_f32(s));
+	return sqrt(vget_lane_f32(h, 0) + vget_lane_f32(h, 1));
+}
+
+static int
+countEqualNeon(const uint8_t * x, const uint8_t * y, int size)
+{
+	uint8x16_t one = vdupq_n_u8(1);
+	uint32x4_t n = vdupq_n_u32(0);
+	for (int a(0); a < size; a += 32){
+		uint8x16_t lo = vandq_u8(vceqq_u8(vld1q_u8(x + a),      vld1q_u8(y + a)),      one);
+		uint8x16_t hi = vandq_u8(vceqq_u8(vld1q_u8(x + a + 16), vld1q_u8(y + a + 16)), one);
+		n = vaddq_u32(n, vpaddlq_u16(vpaddlq_u8(vaddq_u8(lo, hi))));
+	}
+	uint64x2_t s = vpaddlq_u32(n);
+	return (int) (vgetq_lane_u64(s, 0) + vgetq_lane_u64(s, 1));
+}
+#endif
+
+
+/**************************************************************
+ * Dispatch: the version is chosen once, at the first call
+ **************************************************************/
+struct Kernels {
+	void  (*addScaledRow)(float *, const float *, float, int);
+	float (*distance)(const float *, const float *, int);
+	int   (*countEqual)(const uint8_t *, const uint8_t *, int);
+	const char * name;
+};
+
+static const Kernels &
+getKernels()
+{
+	static const Kernels kernels = [](){
+		Kernels k = {addScaledRowScalar, distanceScalar, countEqualScalar, "scalar"};
+#ifdef HAVE_AVX2_KERNELS
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2")){
+			k.addScaledRow = addScaledRowAvx2;
+			k.distance = distanceAvx2;
+			k.countEqual = countEqualAvx2;
+			k.name = "avx2";
+		}
+#endif
+#ifdef HAVE_NEON_KERNELS
+		k.addScaledRow = addScaledRowNeon;
+		k.distance = distanceNeon;
+		k.countEqual = countEqualNeon;
+		k.name = "neon";
+#endif
+		return k;
+	}();
+	return kernels;
+}
+
+void
+addScaledRow(float * acc, const float * row, float scale, int size)
+{
+	getKernels().addScaledRow(acc, row, scale, size);
+}
+
+float
+distance(const float * x, const float * y, int size)
+{
+	return getKernels().distance(x, y, size);
+}
+
+int
+countEqual(const uint8_t * x, const uint8_t * y, int size)
+{
+	return getKernels().countEqual(x, y, size);
+}
+
+const char *
+kernelName()
+{
+	return getKernels().name;
+}
@@ -0,0 +1,52 @@
+/* Copyright (c) 2012 Guillaume Collet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __KERNELS_H__
+#define __KERNELS_H__
+
+#include <stdint.h>
+
+/*
+ * Kernels on rows of floats used by the statistics based on a
+ * scoring matrix (trident, mvector).
+ * The rows have a size multiple of 8 (see ScoringMatrix::getStride)
+ * and are padded with zeros.
+ * countEqual compares rows of bytes (the encoded sequences of the
+ * identity filter), their size is a multiple of 32.
+ * An AVX2 (x86) or NEON (arm) version is chosen at run time, the
+ * scalar version is used otherwise. The sums are done in 8 lanes
+ * combined in the same order by all the versions, so the results
+ * do not depend on the CPU.
+ */
+
+/* acc[a] += scale * row[a] for a in [0, size[ */
+void addScaledRow(float * acc, const float * row, float scale, int size);
+
+/* Euclidean distance √(∑(x[a]-y[a])²) for a in [0, size[ */
+float distance(const float * x, const float * y, int size);
+
+/* Number of a in [0, size[ such that x[a] == y[a] */
+int countEqual(const uint8_t * x, const uint8_t * y, int size);
+
+/* Name of the version used ("avx2", "neon" or "scalar") */
+const char * kernelName();
+
+#endif
@@ -20,19 +20,281 @@
  */
 
 #include <iostream>
-#include <ctime>
+#include <chrono>
+#include <mutex>
+#include <fstream>
+#include <algorithm>
+#include <dirent.h>
+#include <sys/stat.h>
 
 #include "msa.h"
 #include "options.h"
 #include "statistic.h"
+#include "smooth.h"
+#include "bootstrap.h"
+#include "filter.h"
 #include "scoring_matrix.h"
+#include "parallel.h"
+#include "profile.h"
 
 using namespace std;
 
+/* Reduce a pathname in a basename */
+static string basename(const string & fname)
+{
+	size_t pos = fname.find_last_of('/');
+	return pos == string::npos ? fname : fname.substr(pos + 1);
+}
+
+/*
+ * List the multiple alignments of the batch : the files of the
+ * directory batch (sorted by name, hidden files excluded), or the
+ * lines of the file batch (empty lines and lines starting by # excluded)
+ */
+static vector<string> listBatch(const string & batch)
+{
+	vector<string> files;
+	struct stat info;
+	if (stat(batch.c_str(), &info) != 0){
+		cerr << "Cannot open " << batch << "\n";
+		exit(0);
+	}
+	if (S_ISDIR(info.st_mode)){
+		DIR * dir = opendir(batch.c_str());
+		if (dir == NULL){
+			cerr << "Cannot open directory " << batch << "\n";
+			exit(0);
+		}
+		struct dirent * entry;
+		while ((entry = readdir(dir)) != NULL){
+			string path = batch + "/" + entry->d_name;
+			if (entry->d_name[0] != '.' && stat(path.c_str(), &info) == 0 && S_ISREG(info.st_mode)){
+				files.push_back(path);
+			}
+		}
+		closedir(dir);
+		sort(files.begin(), files.end());
+	} else {
+		ifstream list(batch.c_str());
+		string line;
+		while (getline(list, line)){
+			if (!line.empty() && line[line.size() - 1] == '\r'){
+				line.erase(line.size() - 1);
+			}
+			if (!line.empty() && line[0] != '#'){
+				files.push_back(line);
+			}
+		}
+	}
+	return files;
+}
+
+/*
+ * Read the multiple alignment input and calculate the statistics of -s.
+ * With a single statistic, the results are written in out_name.
+ * With several statistics, the column statistics are written
+ * in one table and the others in their own file (out_name.name).
+ * If combined is given, all the results are written in it, each one
+ * after a line "# input" (or "# input name" for the statistics which
+ * are not in the table). The names of the files written are added
+ * to out_files.
+ * With -w, each column statistic is followed in the table by its
+ * smoothed scores for each width (name.w3, name.w5...), all computed
+ * from the same scores.
+ * With -R, the table ends with the mean and the 95% interval of each
+ * column statistic over the bootstrap replicates (name.mean, name.low,
+ * name.high).
+ */
+static void analyseFile(const string & input, const string & out_name, Writer * combined, vector<string> & out_files)
+{
+	const vector<string> & names = Options::Get().statistics;
+	vector<Statistic *> stats;
+	for (int s(0); s < (int) names.size(); ++s){
+		stats.push_back(StatisticFactory::CreateByName(names[s]));
+	}
+
+	/*
+	 * Read the multiple alignment once for all statistics
+	 * (weights, counts and gaps are calculated once in msa),
+	 * with -r, -x or -d the statistics are calculated on a view
+	 * (of the representative sequences with -d)
+	 */
+	Msa whole(input);
+	unique_ptr<Msa> view;
+	vector<int> rows = Options::Get().rows;
+	int first = Options::Get().first_col;
+	int last = Options::Get().last_col > 0 ? Options::Get().last_col : whole.getNcol();
+	if (Options::Get().max_id < 1){
+		int nseq = rows.empty() ? whole.getNseq() : (int) rows.size();
+		rows = filterIdentity(whole, rows, first, last, Options::Get().max_id);
+		if (Options::Get().batch.empty()){
+			cout << "\nIdentity filter : " << rows.size() << " of " << nseq << " sequences kept (max id " << Options::Get().max_id << ")\n";
+		}
+	}
+	if (!rows.empty() || Options::Get().last_col > 0){
+		view.reset(new Msa(whole, rows, first, last));
+	}
+	Msa & msa = view ? *view : whole;
+	
+	/* 
+	 * Calculate the statistics & print them
+	 */
+	const vector<int> & windows = Options::Get().windows;
+	int nrep = Options::Get().bootstrap;
+	vector<string> table_names;
+	vector<Stat1D *> table;
+	vector<Stat1D *> derived;
+	for (int s(0); s < (int) stats.size(); ++s){
+		{
+			ScopedTimer timer("calculate " + names[s]);
+			stats[s]->calculate(msa);
+		}
+		Stat1D * stat1d = dynamic_cast<Stat1D *>(stats[s]);
+		if ((stats.size() > 1 || !windows.empty() || nrep > 0) && stat1d){
+			table_names.push_back(names[s]);
+			table.push_back(stat1d);
+			if (!windows.empty()){
+				ScopedTimer timer("smooth " + names[s]);
+				int first = (int) derived.size();
+				smoothSweep(*stat1d, windows, derived);
+				for (int w(0); w < (int) windows.size(); ++w){
+					table_names.push_back(names[s] + ".w" + to_string(windows[w]));
+					table.push_back(derived[first + w]);
+				}
+			}
+			continue;
+		}
+		ScopedTimer timer("print " + names[s]);
+		if (combined){
+			combined->text("# " + input + (stats.size() > 1 ? " " + names[s] : "")).endl();
+			stats[s]->write(msa, *combined);
+		} else {
+			string fname = stats.size() > 1 ? out_name + "." + names[s] : out_name;
+			stats[s]->print(msa, fname);
+			out_files.push_back(fname);
+		}
+	}
+	if (nrep > 0){
+		/* All the statistics are column statistics (checked in main) */
+		int first = (int) derived.size();
+		bootstrapStats(msa, names, nrep, (uint64_t) Options::Get().seed, derived);
+		const char * summary[3] = {".mean", ".low", ".high"};
+		for (int s(0); s < 3 * (int) names.size(); ++s){
+			table_names.push_back(names[s / 3] + summary[s % 3]);
+			table.push_back(derived[first + s]);
+		}
+	}
+	if (!table.empty()){
+		ScopedTimer timer("print table");
+		if (combined){
+			combined->text("# " + input).endl();
+			printTable(table_names, table, *combined, msa.getFirstCol());
+		} else {
+			Writer out(out_name);
+			printTable(table_names, table, out, msa.getFirstCol());
+			out_files.insert(out_files.begin(), out_name);
+		}
+	}
+	for (int s(0); s < (int) stats.size(); ++s){
+		delete stats[s];
+	}
+	for (int s(0); s < (int) derived.size(); ++s){
+		delete derived[s];
+	}
+}
+
+/*
+ * Batch mode : the alignments are shared among the threads, one
+ * alignment per thread at a time (the loops on the columns are then
+ * run serially). The statistics factory and the scoring matrix are
+ * initialized once.
+ * The results of each alignment go in the directory given by -o,
+ * in a file named after the alignment (<file name>.txt), or with -C,
+ * in the file given by -o, in the order of the batch. Two alignments
+ * with the same file name (in different directories) would write in
+ * the same file : the batch is then rejected.
+ */
+static int analyseBatch(const string & batch, const string & out_name)
+{
+	vector<string> files = listBatch(batch);
+	int nfile = (int) files.size();
+	cout << "Batch: " << nfile << " multiple alignments in " << batch << "\n";
+	vector<string> unused;
+	if (Options::Get().combined){
+		/* The results are kept in memory until the preceding ones are written */
+		Writer out(out_name);
+		vector<string> results(nfile);
+		vector<bool> done(nfile, false);
+		int next = 0;
+		mutex lock;
+		parallelFor(0, nfile, [&](int first, int last){
+			for (int f(first); f < last; ++f){
+				string result;
+				{
+					Writer mem(&result);
+					analyseFile(files[f], "", &mem, unused);
+				}
+				lock_guard<mutex> guard(lock);
+				results[f].swap(result);
+				done[f] = true;
+				while (next < nfile && done[next]){
+					out.text(results[next]);
+					string().swap(results[next]);
+					next++;
+				}
+			}
+		}, 1);
+	} else {
+		vector<string> out_names(nfile);
+		for (int f(0); f < nfile; ++f){
+			out_names[f] = basename(files[f]) + ".txt";
+		}
+		sort(out_names.begin(), out_names.end());
+		vector<string>::iterator twice = adjacent_find(out_names.begin(), out_names.end());
+		if (twice != out_names.end()){
+			cerr << "error : several alignments of " << batch << " would write " << out_name << "/" << *twice << ", use -C or rename them\n";
+			exit(0);
+		}
+		mkdir(out_name.c_str(), 0777);
+		struct stat info;
+		if (stat(out_name.c_str(), &info) != 0 || !S_ISDIR(info.st_mode)){
+			cerr << "Cannot create directory " << out_name << "\n";
+			exit(0);
+		}
+		parallelFor(0, nfile, [&](int first, int last){
+			vector<string> out_files;
+			for (int f(first); f < last; ++f){
+				analyseFile(files[f], out_name + "/" + basename(files[f]) + ".txt", NULL, out_files);
+			}
+		}, 1);
+	}
+	return nfile;
+}
+
+/*
+ * Print the profile of the run (-P) on the standard output,
+ * or write it in JSON in the file given by -J
+ */
+static void printProfile()
+{
+	if (Options::Get().profile){
+		Profile::print(cout);
+	}
+	const string & json_name = Options::Get().profile_json;
+	if (!json_name.empty()){
+		ofstream json(json_name.c_str());
+		if (!json.is_open()){
+			cerr << "Cannot open file " << json_name << "\n";
+			exit(0);
+		}
+		Profile::printJson(json);
+	}
+}
+
 int main (int argc, char **argv)
 {
-	clock_t t1,t2;
-	t1 = clock();
+	chrono::steady_clock::time_point t1, t2;
+	t1 = chrono::steady_clock::now();
 	
 	/* 
 	 * Parses command line 
@@ -45,6 +307,7 @@ int main (int argc, char **argv)
 		Options::Get().print_usage();
 		exit(0);
 	}
+	Profile::enable(Options::Get().profile || !Options::Get().profile_json.empty());
 	cout << "Statistic: " << Options::Get().statistic << "\n";
 	/* 
 	 * Initiates Statistic factory
@@ -57,22 +320,59 @@ int main (int argc, char **argv)
 	}
 	
 	/*
-	 * Read the multiple alignment 
+	 * Check the statistics before reading the alignments
 	 */
-	Msa msa(Options::Get().input_fname);
-	
-	/* 
-	 * Calculate the statistic & print it
+	const vector<string> & names = Options::Get().statistics;
+	try {
+		for (int s(0); s < (int) names.size(); ++s){
+			Statistic * stat = StatisticFactory::CreateByName(names[s]);
+			bool column = dynamic_cast<Stat1D *>(stat) != NULL;
+			delete stat;
+			if (Options::Get().bootstrap > 0 && !column){
+				cerr << "error : only the column statistics can be bootstrapped (-R), not " << names[s] << "\n";
+				exit(0);
+			}
+		}
+	} catch (exception &e){
+		cerr << "Statistic " << e.what();
+		exit(0);
+	}
+	if (names.empty()){
+		cerr << "No statistic given\n";
+		exit(0);
+	}
+
+	string out_name = Options::Get().output_fname;
+	if (!Options::Get().batch.empty()){
+		int nfile;
+		{
+			ScopedTimer timer("total");
+			nfile = analyseBatch(Options::Get().batch, out_name);
+		}
+		t2 = chrono::steady_clock::now();
+		cout << "Mstatx computed " << nfile << " multiple alignments in "<< chrono::duration<double>(t2 - t1).count() <<" seconds\nResults are written in " << out_name << "\n\n";
+		printProfile();
+		return 0;
+	}
+
+	/*
+	 * Calculate the statistics of the multiple alignment
 	 */
-	Statistic * stat = StatisticFactory::CreateByName(Options::Get().statistic);
-	stat->calculate(msa);
-	stat->print(msa);
-	delete stat;
+	vector<string> out_files;
+	{
+		ScopedTimer timer("total");
+		analyseFile(Options::Get().input_fname, out_name, NULL, out_files);
+	}
 	
 	/*
-	 * Print time
+	 * Print time (wall-clock) and the profile
 	 */
-	t2 = clock();		
-	cout << "Mstatx computed in "<< (t2 - t1) / (double)CLOCKS_PER_SEC <<" seconds\nResults are written in " << Options::Get().output_fname << "\n\n";
+	t2 = chrono::steady_clock::now();
+	cout << "Mstatx computed in "<< chrono::duration<double>(t2 - t1).count() <<" seconds\nResults are written in";
+	for (int f(0); f < (int) out_files.size(); ++f){
+		cout << " " << out_files[f];
+	}
+	cout << "\n\n";
+	printProfile();
 	return 0;
 }
@@ -0,0 +1,80 @@
+/* Copyright (c) 2012 Guillaume Collet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "mapped_file.h"
+
+using namespace std;
+
+/** Constructor from a filename fname.
+ *  The file is mapped if it is a regular file, read otherwise.
+ */
+MappedFile :: MappedFile(string fname) : data(NULL), size(0), map_addr(NULL)
+{
+	int fd = open(fname.c_str(), O_RDONLY);
+	if (fd < 0){
+	  cerr << "Cannot open file " << fname << "\n";
+		exit(0);
+	}
+	struct stat st;
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0){
+		void * addr = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (addr != MAP_FAILED){
+			madvise(addr, (size_t) st.st_size, MADV_SEQUENTIAL);
+			map_addr = addr;
+			data = (const char *) addr;
+			size = (size_t) st.st_size;
+		}
+	}
+	close(fd);
+	
+	/* Fallback: read the file in a buffer */
+	if (map_addr == NULL){
+		ifstream file(fname.c_str(), ios::binary);
+		if (!file.good()){
+		  cerr << "Cannot open file " << fname << "\n";
+			exit(0);
+		}
+		char block[1 << 16];
+		while (file.good()){
+			file.read(block, sizeof(block));
+			buffer.insert(buffer.end(), block, block + file.gcount());
+		}
+		data = buffer.empty() ? "" : &buffer[0];
+		size = buffer.size();
+	}
+}
+
+/* Destructor */
+MappedFile :: ~MappedFile()
+{
+	if (map_addr != NULL){
+		munmap(map_addr, size);
+	}
+}
@@ -0,0 +1,51 @@
+/* Copyright (c) 2012 Guillaume Collet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __MAPPED_FILE_H__
+#define __MAPPED_FILE_H__
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+using namespace std;
+
+/*
+ * MappedFile gives a read-only view of the whole content of a file.
+ * Regular files are mapped in memory (no copy), other files (pipes,
+ * special files) are read in a buffer.
+ */
+class MappedFile
+{
+protected:
+	const char * data;     /**< First byte of the file content */
+	size_t       size;     /**< Number of bytes of the file */
+	void       * map_addr; /**< Address of the mapping (NULL if read in buffer) */
+	vector<char> buffer;   /**< Content of the file when it cannot be mapped */
+
+public:
+	MappedFile(string fname);
+	~MappedFile();
+	const char * getData() const {return data;};	/**< Returns the first byte of the file */
+	size_t       getSize() const {return size;};	/**< Returns the number of bytes of the file */
+};
+
+#endif
@@ -0,0 +1,96 @@
+/* Copyright (c) 2012 Guillaume Collet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "mi.h"
+
+#include <cmath>
+
+/** pairScore(msa, x, y, joint, stride)
+ *
+ * Mutual information of columns x and y :
+ * MI(x,y) = \sum_{a,b} p_{ab} log(\frac{p_{ab}}{p_a p_b})
+ * p_a, p_b and p_{ab} are the weighted counts (Henikoff weights sum to 1)
+ * Gaps are considered as a symbol.
+ */
+float
+MIStat :: pairScore(Msa & msa, int x, int y, const float * joint, int stride)
+{
+	int K = (int) msa.getAlphabet().size();
+	const float * p_x = msa.getWeightedCount(x);
+	const float * p_y = msa.getWeightedCount(y);
+	float mi = 0.0;
+	for (int a(0); a < K; ++a){
+		if (p_x[a] == 0.0){
+			continue;
+		}
+		const float * p_ab = joint + a * stride;
+		for (int b(0); b < K; ++b){
+			if (p_ab[b] != 0.0){
+				mi += p_ab[b] * log(p_ab[b] / (p_x[a] * p_y[b]));
+			}
+		}
+	}
+	return mi;
+}
+
+void
+MIStat :: calculate(Msa & msa)
+{
+	calcPairs(msa);
+}
+
+/** calculate(msa)
+ *
+ * Average product correction of Dunn et al. (2008) :
+ * APC(x,y) = MI(x,y) - \frac{\bar{MI}(x) \bar{MI}(y)}{\bar{MI}}
+ * With \bar{MI}(x) the mean MI of column x with the other columns
+ * and \bar{MI} the mean MI of all the pairs
+ */
+void
+MIAPCStat :: calculate(Msa & msa)
+{
+	calcPairs(msa);
+	if (ncol < 3){
+		return;
+	}
+	vector<double> mean(ncol, 0.0);
+	double total = 0.0;
+	for (int x(0); x < ncol - 1; ++x){
+		for (int y(x + 1); y < ncol; ++y){
+			float mi = cor_stat[pairIndex(x, y)];
+			mean[x] += mi;
+			mean[y] += mi;
+			total += mi;
+		}
+	}
+	for (int x(0); x < ncol; ++x){
+		mean[x] /= ncol - 1;
+	}
+	total /= (double) cor_stat.size();
+	if (total <= 0.0){
+		return;
+	}
+	for (int x(0); x < ncol - 1; ++x){
+		for (int y(x + 1); y < ncol; ++y){
+			cor_stat[pairIndex(x, y)] -= mean[x] * mean[y] / total;
+		}
+	}
+}
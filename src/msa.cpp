@@ -21,110 +21,1170 @@
 
 #include <algorithm>
 #include <iostream>
+#include <mutex>
 #include <fstream>
 #include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <sys/stat.h>
 
 #include "msa.h"
-#include "options.h"
+#include "context.h"
+#include "parallel.h"
+#include "fasta.h"
+#include "mapped_file.h"
+#include "alphabet.h"
+#include "profile.h"
+#include "arena.h"
+#include "input.h"
+#include "reduce.h"
 
 using namespace std;
 
 
+/* The messages on the alignment are not printed in batch mode (or if quiet) */
+static bool
+printMessages()
+{
+	return Context::Get().batch.empty() && !Context::Get().quiet;
+}
+
+
 /**************************************************************
  * This constructor of a multiple alignment reads the 
  * multiple alignment in a multi-fasta format.
- * Once read, the multiple alignment is analysed to find
- * the alphabet used, the number of gaps and the entropy of 
- * each column, and the frequency of each amino acid type.
+ * Once read, the multiple alignment is analysed to find the
+ * alphabet used, the number of gaps and the entropy of each
+ * column, and the frequency of each amino acid type.
+ * In stream mode, only the counts of each column and the
+ * weights of the sequences are kept (see readStream).
+ * With -M, the encoded alignment and its counts are mapped
+ * from the cache of the file if it is up to date (readCache).
  **************************************************************/
-Msa :: Msa(string fname)
+Msa :: Msa(string fname) : col_data(NULL), bit_data(NULL), col_bits(0), nword(0), streamed(false), state_offset(0), state_checksum(0), first_col(0)
 {
+	ScopedTimer timer("load");
 	/* Open file */
-	if (Options::Get().verbose){
+	if (Context::Get().verbose){
 		cout << "Read Multiple Alignment in " << fname << "\n";
 	}
-	ifstream file(fname.c_str());
-	if (!file.good()){
-	  cerr << "Cannot open file " << fname << "\n";
+	if (Context::Get().stream){
+		readStream(fname);
+	} else if (!Context::Get().msa_cache || !readCache(fname)){
+		readFile(fname);
+		analyse();
+		if (Context::Get().msa_cache){
+			writeCache(fname);
+		}
+	}
+	printVerbose();
+}
+
+
+/**************************************************************
+ * This constructor reads a multiple alignment in multi-fasta
+ * format from the size bytes of data (e.g. from a program
+ * embedding the library), name is only used in the messages.
+ * The stream mode, the incremental mode and the cache need a
+ * file, they are ignored.
+ **************************************************************/
+Msa :: Msa(const char * data, size_t size, string name) : col_data(NULL), bit_data(NULL), col_bits(0), nword(0), streamed(false), state_offset(0), state_checksum(0), first_col(0)
+{
+	ScopedTimer timer("load");
+	if (Context::Get().verbose){
+		cout << "Read Multiple Alignment in " << name << "\n";
+	}
+	string fasta;
+	if (loadAlignment(name, data, size, fasta)){
+		readBuffer(fasta.data(), fasta.size(), name);
+	} else {
+		readBuffer(data, size, name);
+	}
+	analyse();
+	printVerbose();
+}
+
+
+/**************************************************************
+ * printVerbose() prints the alphabet, the alignment and its
+ * counts in verbose mode.
+ **************************************************************/
+void
+Msa :: printVerbose()
+{
+	if (!Context::Get().verbose){
+		return;
+	}
+	cout << "\nAlphabet :\n";
+  for(int i(0); i < (int) alphabet.size(); ++i){
+		cout << alphabet[i] << ";";
+	}
+	cout << "\n";
+	cout << "\nMultiple Alignment :\n";
+  for(int i(0); i < nseq && !streamed; ++i){
+		for (int j(0); j < ncol; ++j){
+			cout << getSymbol(i, j);
+		}
+		cout << "\n";
+	}
+	cout << "\nAA Frequencies :\n";
+	for (int i(0); i < (int) aa_freq.size(); ++i){
+		cout << aa_freq[i] << ";";
+	}
+	cout << "\n";
+	cout << "\nGap counts :\n";
+	for (int i(0); i < (int) gap_counts.size(); ++i){
+		cout << gap_counts[i] << ";";
+	}
+	cout << "\n";
+	cout << "\nAA Entropy :\n";
+	for (int i(0); i < (int) entropy.size(); ++i){
+		if (gap_counts[i] < nseq/10){
+	  	cout << entropy[i] << ";";
+		} else {
+			cout << "-12.0;";
+		}
+	}
+	cout << "\n";
+	cout << "\nAA Types :\n";
+	for (int i(0); i < (int) nb_type.size(); ++i){
+			cout << nb_type[i] << ";";
+	}
+	cout << "\n";
+}
+
+
+/**************************************************************
+ * packBlock(sym, nrow, nbits, planes, nword) packs nrow <= 64
+ * symbols in one word of each of the nbits bit planes
+ * planes[b * nword]: bit r of plane b is bit b of symbol r.
+ **************************************************************/
+static void
+packBlock(const uint8_t * sym, int nrow, int nbits, uint64_t * planes, int nword)
+{
+	for (int b(0); b < nbits; ++b){
+		uint64_t word = 0;
+		for (int r(0); r < nrow; ++r){
+			word |= (uint64_t) ((sym[r] >> b) & 1) << r;
+		}
+		planes[(size_t) b * nword] = word;
+	}
+}
+
+
+/**************************************************************
+ * splitSymbols(planes, nbits, nword, w, valid, mask) gives in
+ * mask[a] the rows of word w of a packed column having the
+ * symbol a, for the 2^nbits symbols. valid masks the rows
+ * past the end of the column. Each plane splits the masks of
+ * the previous ones in two: 2^(nbits+1) operations in all.
+ **************************************************************/
+static inline void
+splitSymbols(const uint64_t * planes, int nbits, int nword, int w, uint64_t valid, uint64_t * mask)
+{
+	mask[0] = valid;
+	for (int b(0); b < nbits; ++b){
+		uint64_t plane = planes[(size_t) b * nword + w];
+		int half = 1 << b;
+		for (int a(0); a < half; ++a){
+			mask[a + half] = mask[a] & plane;
+			mask[a] &= ~plane;
+		}
+	}
+}
+
+
+/** Mask of the rows of word w of a column of nseq rows */
+static inline uint64_t
+validRows(int nseq, int w)
+{
+	int n = nseq - w * 64;
+	return n >= 64 ? ~(uint64_t) 0 : (((uint64_t) 1 << n) - 1);
+}
+
+
+/**************************************************************
+ * defineAlphabet(records) finds the symbols used in the
+ * sequences (in upper case) and sorts them in order of first
+ * appearance in the columns of the alignment (column by
+ * column). The sequences are read by blocks of rows among the
+ * threads, each thread keeps the first position of each byte.
+ **************************************************************/
+void
+Msa :: defineAlphabet(const vector<FastaRecord> & records)
+{
+	ScopedTimer timer("defineAlphabet");
+	const int block = 64;
+	const uint64_t none = ~(uint64_t) 0;
+	vector<uint64_t> first_pos(256, none);	/**< First position col * nseq + row of each byte */
+	mutex merge_lock;
+	parallelFor(0, (nseq + block - 1) / block, [&](int first, int last){
+		Scratch scratch;
+		uint8_t * rows = scratch.get<uint8_t>(ncol);
+		uint64_t * pos = scratch.get<uint64_t>(256, none);
+		for (int b(first); b < last; ++b){
+			int row0 = b * block;
+			int nrow = (row0 + block < nseq) ? block : nseq - row0;
+			for (int r(row0); r < row0 + nrow; ++r){
+				int size = records[r].decodeResidues(&rows[0], ncol);
+				if (size != ncol){
+					cerr << "error : sequence " << mali_name[r] << " has " << size << " symbols instead of " << ncol << "\n";
+					exit(0);
+				}
+				for (int col(0); col < ncol; ++col){
+					uint64_t p = (uint64_t) col * nseq + r;
+					if (p < pos[rows[col]]){
+						pos[rows[col]] = p;
+					}
+				}
+			}
+		}
+		lock_guard<mutex> guard(merge_lock);
+		for (int c(0); c < 256; ++c){
+			first_pos[c] = min(first_pos[c], pos[c]);
+		}
+	});
+	
+	vector<pair<uint64_t,int> > order;
+	for (int c(0); c < 256; ++c){
+		if (first_pos[c] != none){
+			order.push_back(make_pair(first_pos[c], c));
+		}
+	}
+	sort(order.begin(), order.end());
+	alphabet.clear();
+	for (int c(0); c < 256; ++c){
+		alphabet_pos[c] = -1;
+	}
+	for (size_t i(0); i < order.size(); ++i){
+		alphabet_pos[order[i].second] = (int) alphabet.size();
+		alphabet.push_back((char) order[i].second);
+	}
+}
+
+
+/**************************************************************
+ * This constructor makes a view of the sequences rows (their
+ * positions in parent, all if empty) and of the columns
+ * [first, last[ of parent, without reading the file again.
+ * With all the sequences, the view shares the columns of
+ * parent (parent must then outlive it). Otherwise, the
+ * encoded symbols of the rows are gathered column by column.
+ * The view keeps the alphabet of parent; its counts, gaps,
+ * entropy and sequence weights are those of the view.
+ **************************************************************/
+Msa :: Msa(const Msa & parent, const vector<int> & rows, int first, int last) : col_data(NULL), bit_data(NULL), col_bits(parent.col_bits), nword(parent.nword), streamed(false), state_offset(0), state_checksum(0)
+{
+	ScopedTimer timer("view");
+	if (parent.streamed){
+		cerr << "error : no view of an alignment read in stream mode\n";
 		exit(0);
 	}
+	/* An alignment without columns only has the empty range [0, 0[ */
+	if (first < 0 || last > parent.ncol || (first >= last && !(first == 0 && last == 0))){
+		cerr << "error : the columns " << first + 1 << "-" << last << " are not in the alignment (" << parent.ncol << " columns)\n";
+		exit(0);
+	}
+	for (int r(0); r < (int) rows.size(); ++r){
+		if (rows[r] < 0 || rows[r] >= parent.nseq){
+			cerr << "error : the sequence " << rows[r] + 1 << " is not in the alignment (" << parent.nseq << " sequences)\n";
+			exit(0);
+		}
+	}
+	alphabet = parent.alphabet;
+	copy(parent.alphabet_pos, parent.alphabet_pos + 256, alphabet_pos);
+	ncol = last - first;
+	first_col = parent.first_col + first;
+	
+	if (rows.empty()){
+		nseq = parent.nseq;
+		mali_name = parent.mali_name;
+		col_data = col_bits ? NULL : parent.col_data + (size_t) first * nseq;
+		bit_data = col_bits ? parent.getPlanes(first) : NULL;
+	} else {
+		nseq = (int) rows.size();
+		nword = (nseq + 63) / 64;
+		for (int r(0); r < nseq; ++r){
+			mali_name.push_back(parent.mali_name[rows[r]]);
+		}
+		if (col_bits){
+			mali_bits.assign((size_t) ncol * col_bits * nword, 0);
+		} else {
+			mali_col.resize((size_t) nseq * ncol);
+		}
+		parallelFor(0, ncol, [&](int begin, int end){
+			Scratch scratch;
+			uint8_t * buf = parent.col_bits ? scratch.get<uint8_t>((size_t) parent.nword * 64) : NULL;
+			uint8_t * sym = scratch.get<uint8_t>((size_t) nword * 64);
+			for (int col(begin); col < end; ++col){
+				const uint8_t * column = parent.getColumn(first + col, buf);
+				uint8_t * out = col_bits ? sym : &mali_col[(size_t) col * nseq];
+				for (int r(0); r < nseq; ++r){
+					out[r] = column[rows[r]];
+				}
+				if (col_bits){
+					uint64_t * planes = &mali_bits[(size_t) col * col_bits * nword];
+					for (int w(0); w < nword; ++w){
+						packBlock(&sym[(size_t) w * 64], min(64, nseq - w * 64), col_bits, planes + w, nword);
+					}
+				}
+			}
+		});
+		col_data = mali_col.data();
+		bit_data = mali_bits.data();
+	}
+	analyse();
+	if (printMessages()){
+		cout << "\nView : nb seq = " << nseq << ", columns " << first_col + 1 << "-" << first_col + ncol << "\n";
+	}
+}
 
+
+/**************************************************************
+ * readFile(fname) maps the file in memory (decompressed and
+ * converted in fasta if needed), defines the alphabet, then
+ * writes the position in alphabet of the residues (in upper
+ * case) directly in the column-major alignment.
+ * With at most 16 symbols (nucleotides, low complexity
+ * alphabets), the columns are bit-packed on the fly, so
+ * a symbol takes 1 to 4 bits instead of a byte.
+ **************************************************************/
+void
+Msa :: readFile(string fname)
+{
+	ScopedTimer timer("readFile");
+	MappedFile file(fname);
+	Profile::addBytes("input", file.getSize());
+	string fasta;
+	if (loadAlignment(fname, file.getData(), file.getSize(), fasta)){
+		readBuffer(fasta.data(), fasta.size(), fname);
+	} else {
+		readBuffer(file.getData(), file.getSize(), fname);
+	}
+}
+
+
+/**************************************************************
+ * readBuffer(data, size, name) reads the alignment in the
+ * size bytes of data (the mapped file or a buffer given by
+ * the caller), name is used in the messages.
+ **************************************************************/
+void
+Msa :: readBuffer(const char * data, size_t size, const string & name)
+{
+	/* Find the sequences (one more than the maximum to know if some are left) */
+	int max_seq = Context::Get().nb_seq;
+	vector<FastaRecord> records;
+	indexFasta(data, size, max_seq > 0 ? max_seq + 1 : -1, records);
+	if (max_seq > 0 && (int) records.size() > max_seq){
+		records.pop_back();
+		cerr << "Warning: only the first " << max_seq << " sequences of " << name << " are read (option -n)\n";
+	}
+	nseq = (int) records.size();
+	ncol = nseq ? records[0].countResidues() : 0;
+	for (int i(0); i < nseq; ++i){
+		mali_name.push_back(records[i].getName());
+	}
+	
+	defineAlphabet(records);
+	int K = (int) alphabet.size();
+	col_bits = 0;
+	if (K <= 16){
+		for (col_bits = 1; (1 << col_bits) < K; ++col_bits);
+	}
+	nword = (nseq + 63) / 64;
+	if (printMessages()){
+		cout << "\nMultiple alignment : nb seq = "<<nseq<<", nb col = "<<ncol<<"\n";
+		printEstimate(nseq, ncol, col_bits ? col_bits : 8);
+	}
 	
-	/* Read file */
-	string s, tmp_seq;
-	while (file.good() && (int) mali_seq.size() < Options::Get().nb_seq){
-		getline(file,s);
-		if (s[0] == '>'){
-			if (mali_name.size() != 0){
-			  mali_seq.push_back(tmp_seq);	
+	/* Read the sequences (in upper case) by blocks of 64 rows, 
+	 * each block is encoded and transposed in the columns.
+	 * If packed, the rows of a block are accumulated in one word
+	 * of each bit plane of each column (bits[b * ncol + col]) */
+	const int block = 64;
+	if (col_bits){
+		mali_bits.assign((size_t) ncol * col_bits * nword, 0);
+	} else {
+		mali_col.resize((size_t) nseq * ncol);
+	}
+	parallelFor(0, (nseq + block - 1) / block, [&](int first, int last){
+		Scratch scratch;
+		uint8_t * rows = scratch.get<uint8_t>((size_t) block * ncol);
+		uint64_t * bits = scratch.get<uint64_t>((size_t) col_bits * ncol);
+		for (int b(first); b < last; ++b){
+			int row0 = b * block;
+			int nrow = (row0 + block < nseq) ? block : nseq - row0;
+			fill(bits, bits + (size_t) col_bits * ncol, 0);
+			for (int r(0); r < nrow; ++r){
+				uint8_t * row = &rows[(size_t) r * ncol];
+				records[row0 + r].decodeResidues(row, ncol);
+				for (int col(0); col < ncol; ++col){
+					row[col] = (uint8_t) alphabet_pos[row[col]];
+				}
+				for (int p(0); p < col_bits; ++p){
+					uint64_t * plane = &bits[(size_t) p * ncol];
+					for (int col(0); col < ncol; ++col){
+						plane[col] |= (uint64_t) ((row[col] >> p) & 1) << r;
+					}
+				}
 			}
-			if ((int) mali_seq.size() < Options::Get().nb_seq){
-  			mali_name.push_back(s.substr(1, s.find_first_of(' ') - 1));
+			if (col_bits){
+				for (int col(0); col < ncol; ++col){
+					for (int p(0); p < col_bits; ++p){
+						mali_bits[((size_t) col * col_bits + p) * nword + b] = bits[(size_t) p * ncol + col];
+					}
+				}
+				continue;
 			}
-			tmp_seq.clear();
-		} else {
-			tmp_seq = tmp_seq + s;
+			for (int col(0); col < ncol; ++col){
+				uint8_t * column = &mali_col[(size_t) col * nseq + row0];
+				for (int r(0); r < nrow; ++r){
+					column[r] = rows[(size_t) r * ncol + col];
+				}
+			}
+		}
+	});
+	col_data = mali_col.data();
+	bit_data = mali_bits.data();
+}
+
+
+/*
+ * Cache of an alignment (native byte order, checked by the order field) :
+ * the header, the alphabet, the names (separated by '\n'), the columns
+ * (mali_bits or mali_col), sym_count, type_list, nb_type, gap_counts,
+ * aa_freq and entropy. Each part starts at a multiple of 8 bytes, so
+ * the columns are used in place in the mapped file. The cache is valid
+ * while the size and modification time of the alignment file and the
+ * number of sequences read (-n) are unchanged.
+ */
+struct MsaCacheHeader {
+	char     magic[8];   /**< "MSTXMSA" */
+	uint32_t version;    /**< 2 */
+	uint32_t order;      /**< 0x01020304 written in native order */
+	uint64_t src_size;   /**< Size of the alignment file */
+	int64_t  src_mtime;  /**< Modification time of the alignment file (seconds) */
+	int64_t  src_mtime_ns; /**< Nanoseconds of the modification time */
+	int32_t  max_seq;    /**< Option -n of the run writing the cache */
+	int32_t  nseq;
+	int32_t  ncol;
+	int32_t  size;       /**< Size of the alphabet */
+	int32_t  col_bits;
+	int32_t  nword;
+	uint64_t names_size; /**< Number of bytes of the names */
+};
+
+static string
+msaCacheName(const string & fname)
+{
+	return fname + ".msabin";
+}
+
+/* Fill the fields of the header which identify the alignment file fname */
+static bool
+msaSourceHeader(const string & fname, MsaCacheHeader & header)
+{
+	struct stat info;
+	if (stat(fname.c_str(), &info) != 0 || !S_ISREG(info.st_mode)){
+		return false;
+	}
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, "MSTXMSA", 8);
+	header.version = 2;
+	header.order = 0x01020304;
+	header.src_size = (uint64_t) info.st_size;
+	header.src_mtime = (int64_t) info.st_mtim.tv_sec;
+	header.src_mtime_ns = (int64_t) info.st_mtim.tv_nsec;
+	header.max_seq = (int32_t) Context::Get().nb_seq;
+	return true;
+}
+
+/* Sizes of the parts of the cache, rounded to 8 bytes */
+static void
+msaCacheParts(const MsaCacheHeader & h, size_t part[9])
+{
+	size_t cells = (size_t) h.ncol * h.size;
+	part[0] = h.size + h.names_size;
+	part[1] = h.col_bits ? (size_t) h.ncol * h.col_bits * h.nword * sizeof(uint64_t) : (size_t) h.nseq * h.ncol;
+	part[2] = cells * sizeof(int32_t);
+	part[3] = cells;
+	part[4] = (size_t) h.ncol * sizeof(int32_t);
+	part[5] = (size_t) h.ncol * sizeof(int32_t);
+	part[6] = (size_t) h.size * sizeof(float);
+	part[7] = (size_t) h.ncol * sizeof(float);
+	part[8] = 0;
+	for (int i(0); i < 8; ++i){
+		part[i] = (part[i] + 7) / 8 * 8;
+	}
+}
+
+
+/**************************************************************
+ * readCache(fname) maps the cache of the alignment file fname
+ * if it is up to date and takes the columns in place in the
+ * mapped memory. The counts are copied (their size depends
+ * on the number of columns only).
+ * Returns false if there is no valid cache.
+ **************************************************************/
+bool
+Msa :: readCache(const string & fname)
+{
+	ScopedTimer timer("readCache");
+	MsaCacheHeader expected, header;
+	struct stat info;
+	if (!msaSourceHeader(fname, expected) || stat(msaCacheName(fname).c_str(), &info) != 0){
+		return false;
+	}
+	/* A cache written before the last change of the alignment is stale */
+	if (info.st_mtim.tv_sec < expected.src_mtime
+	 || (info.st_mtim.tv_sec == expected.src_mtime && info.st_mtim.tv_nsec <= expected.src_mtime_ns)){
+		return false;
+	}
+	cache.reset(new MappedFile(msaCacheName(fname)));
+	Profile::addBytes("input", cache->getSize());
+	const char * data = cache->getData();
+	size_t part[9];
+	bool ok = cache->getSize() >= sizeof(header);
+	if (ok){
+		memcpy(&header, data, sizeof(header));
+		ok = memcmp(header.magic, expected.magic, 8) == 0
+		  && header.version == expected.version
+		  && header.order == expected.order
+		  && header.src_size == expected.src_size
+		  && header.src_mtime == expected.src_mtime
+		  && header.src_mtime_ns == expected.src_mtime_ns
+		  && header.max_seq == expected.max_seq
+		  && header.nseq >= 0 && header.ncol >= 0
+		  && header.size >= 0 && header.size <= 256
+		  && header.col_bits >= 0 && header.col_bits <= 4
+		  && header.nword == (header.nseq + 63) / 64;
+	}
+	if (ok){
+		msaCacheParts(header, part);
+		size_t total = sizeof(header);
+		for (int i(0); i < 8; ++i){
+			total += part[i];
 		}
+		ok = cache->getSize() == total;
 	}
-	if ((int) mali_seq.size() < Options::Get().nb_seq){
-	  mali_seq.push_back(tmp_seq);
+	if (!ok){
+		cache.reset();
+		return false;
 	}
 	
-	nseq = (int) mali_name.size();
-	ncol = (int) mali_seq[0].size();
-	cout << "\nMultiple alignment : nb seq = "<<nseq<<", nb col = "<<ncol<<"\n";
+	nseq = header.nseq;
+	ncol = header.ncol;
+	col_bits = header.col_bits;
+	nword = header.nword;
+	int K = header.size;
+	const char * p = data + sizeof(header);
+	alphabet.assign(p, K);
+	for (int c(0); c < 256; ++c){
+		alphabet_pos[c] = -1;
+	}
+	for (int a(0); a < K; ++a){
+		alphabet_pos[(unsigned char) alphabet[a]] = a;
+	}
+	const char * name = p + K;
+	for (int i(0); i < nseq; ++i){
+		const char * end = (const char *) memchr(name, '\n', p + K + header.names_size - name);
+		mali_name.push_back(string(name, end));
+		name = end + 1;
+	}
+	p += part[0];
+	col_data = col_bits ? NULL : (const uint8_t *) p;
+	bit_data = col_bits ? (const uint64_t *) p : NULL;
+	p += part[1];
+	size_t cells = (size_t) ncol * K;
+	sym_count.assign((const int32_t *) p, (const int32_t *) p + cells);
+	p += part[2];
+	type_list.assign((const uint8_t *) p, (const uint8_t *) p + cells);
+	p += part[3];
+	nb_type.assign((const int32_t *) p, (const int32_t *) p + ncol);
+	p += part[4];
+	gap_counts.assign((const int32_t *) p, (const int32_t *) p + ncol);
+	p += part[5];
+	aa_freq.assign((const float *) p, (const float *) p + K);
+	p += part[6];
+	entropy.assign((const float *) p, (const float *) p + ncol);
 	
-	/* Change all mali.seq in upper case*/
+	if (printMessages()){
+		cout << "\nMultiple alignment : nb seq = "<<nseq<<", nb col = "<<ncol<<" (cache " << msaCacheName(fname) << ")\n";
+		printEstimate(nseq, ncol, col_bits ? col_bits : 8);
+	}
+	return true;
+}
+
+
+/**************************************************************
+ * writeCache(fname) writes the cache of the alignment file
+ * fname in a temporary file renamed at the end, so concurrent
+ * runs never read a partial cache. The cache is not written
+ * if the directory is read only.
+ **************************************************************/
+void
+Msa :: writeCache(const string & fname) const
+{
+	ScopedTimer timer("writeCache");
+	MsaCacheHeader header;
+	if (!msaSourceHeader(fname, header)){
+		return;
+	}
+	string names;
 	for (int i(0); i < nseq; ++i){
-		for(int j(0); j < ncol; ++j){
-			mali_seq[i][j] = toupper(mali_seq[i][j]);
+		names += mali_name[i] + "\n";
+	}
+	int K = (int) alphabet.size();
+	header.nseq = nseq;
+	header.ncol = ncol;
+	header.size = K;
+	header.col_bits = col_bits;
+	header.nword = nword;
+	header.names_size = names.size();
+	size_t part[9];
+	msaCacheParts(header, part);
+	
+	string tmp_name = msaCacheName(fname) + ".tmp";
+	FILE * file = fopen(tmp_name.c_str(), "wb");
+	if (file == NULL){
+		if (Context::Get().verbose){
+			cerr << "Cannot write the alignment cache " << msaCacheName(fname) << "\n";
+		}
+		return;
+	}
+	size_t cells = (size_t) ncol * K;
+	const char zero[8] = {0};
+	bool ok = true;
+	/* Each part is padded to part[i] bytes */
+	auto writePart = [&](int i, const void * data, size_t size){
+		ok = ok && fwrite(data, 1, size, file) == size
+		        && fwrite(zero, 1, part[i] - size, file) == part[i] - size;
+	};
+	ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	names.insert(0, alphabet);
+	writePart(0, names.data(), names.size());
+	if (col_bits){
+		writePart(1, bit_data, part[1]);
+	} else {
+		writePart(1, col_data, (size_t) nseq * ncol);
+	}
+	writePart(2, sym_count.data(), cells * sizeof(int32_t));
+	writePart(3, type_list.data(), cells);
+	writePart(4, nb_type.data(), ncol * sizeof(int32_t));
+	writePart(5, gap_counts.data(), ncol * sizeof(int32_t));
+	writePart(6, aa_freq.data(), K * sizeof(float));
+	writePart(7, entropy.data(), ncol * sizeof(float));
+	ok = (fclose(file) == 0) && ok;
+	if (!ok || rename(tmp_name.c_str(), msaCacheName(fname).c_str()) != 0){
+		remove(tmp_name.c_str());
+	}
+}
+
+
+/**************************************************************
+ * ownColumns() copies the columns mapped from the cache, or
+ * shared with the parent of a view, in mali_col or mali_bits,
+ * so they can be changed
+ **************************************************************/
+void
+Msa :: ownColumns()
+{
+	if (col_bits ? bit_data == mali_bits.data() : col_data == mali_col.data()){
+		return;
+	}
+	if (col_bits){
+		mali_bits.assign(bit_data, bit_data + (size_t) ncol * col_bits * nword);
+	} else {
+		mali_col.assign(col_data, col_data + (size_t) nseq * ncol);
+	}
+	col_data = mali_col.data();
+	bit_data = mali_bits.data();
+	cache.reset();
+}
+
+
+/**************************************************************
+ * readBlock(file, nrow, rows, cols) reads at most nrow
+ * sequences (in upper case) in rows and writes them column
+ * by column in cols: symbol (row, col) is at col * nrow + row.
+ * Returns the number of sequences read.
+ **************************************************************/
+int
+Msa :: readBlock(FastaStream & file, int nrow, vector<uint8_t> & rows, vector<uint8_t> & cols)
+{
+	string name;
+	vector<uint8_t> residues;
+	int r = 0;
+	while (r < nrow && file.nextRecord(name, residues)){
+		if (ncol < 0){
+			ncol = (int) residues.size();
+		}
+		if ((int) residues.size() != ncol){
+			cerr << "error : sequence " << name << " has " << residues.size() << " symbols instead of " << ncol << "\n";
+			exit(0);
 		}
+		rows.resize((size_t) (r + 1) * ncol);
+		copy(residues.begin(), residues.end(), rows.begin() + (size_t) r * ncol);
+		r++;
 	}
 	
-	/* Analyse the multiple alignment */
-	defineAlphabet();
-	countGap();
-	countFreq();
-	countType();
-	countEntropy();
+	/* Transpose by tiles of 64 rows */
+	cols.resize((size_t) r * ncol);
+	for (int r0(0); r0 < r; r0 += 64){
+		int r1 = (r0 + 64 < r) ? r0 + 64 : r;
+		for (int col(0); col < ncol; ++col){
+			uint8_t * column = &cols[(size_t) col * r];
+			for (int i(r0); i < r1; ++i){
+				column[i] = rows[(size_t) i * ncol + col];
+			}
+		}
+	}
+	return r;
+}
+
+
+/*
+ * State file of the incremental mode (-I, native byte order, checked by
+ * the order field) : the header, then for each column its number of
+ * different bytes, and its bytes in order of appearance with their
+ * counts. The state is used for the input file if a record (or the end
+ * of the file) starts at offset and if the checksum of samples of the
+ * bytes counted is the same: the first and the last 4096 bytes before
+ * offset and STATE_SAMPLES blocks of 4096 bytes spread between them.
+ * So an edit of the counted sequences is found if it changes one of
+ * these bytes (always for files of up to about 260 KB), the whole file
+ * is not read again. The state also keeps the checksum of all the
+ * bytes counted, extended by each run with the bytes appended: it is
+ * checked by readWeights, which reads all the counted sequences again.
+ */
+#define STATE_BLOCK   4096
+#define STATE_SAMPLES 64
+#define FNV_BASIS     14695981039346656037ULL
+
+struct StateHeader {
+	char     magic[8];   /**< "MSTXINC" */
+	uint32_t version;    /**< 3 */
+	uint32_t order;      /**< 0x01020304 written in native order */
+	uint64_t offset;     /**< Offset of the first sequence not counted */
+	uint64_t checksum;   /**< FNV-1a of the samples of the bytes before offset (see stateChecksum) */
+	uint64_t full_checksum; /**< FNV-1a of all the bytes before offset (see prefixChecksum) */
+	int32_t  nseq;       /**< Number of sequences counted */
+	int32_t  ncol;       /**< Number of columns */
+};
+
+/* Checksum of the samples of the bytes before offset in file fname,
+ * false if the file is shorter or if no record starts at offset */
+static bool
+stateChecksum(const string & fname, uint64_t offset, uint64_t & checksum)
+{
+	FILE * file = fopen(fname.c_str(), "rb");
+	if (file == NULL){
+		return false;
+	}
+	/* Starts of the blocks: the first one, the samples and the last one (ended by the byte at offset) */
+	vector<uint64_t> starts(1, 0);
+	if (offset > 2 * STATE_BLOCK){
+		for (int i(1); i <= STATE_SAMPLES; ++i){
+			starts.push_back(offset * i / (STATE_SAMPLES + 1));
+		}
+	}
+	starts.push_back(offset > STATE_BLOCK ? offset - STATE_BLOCK : 0);
+	checksum = FNV_BASIS;
+	vector<char> bytes(STATE_BLOCK + 1);
+	bool ok = true;
+	for (int b(0); b < (int) starts.size() && ok; ++b){
+		bool last = (b + 1 == (int) starts.size());
+		uint64_t size = min((uint64_t) STATE_BLOCK, offset - starts[b]);
+		ok = fseek(file, (long) starts[b], SEEK_SET) == 0;
+		size_t nread = ok ? fread(&bytes[0], 1, size + last, file) : 0;
+		ok = ok && nread >= size && !(last && nread > size && bytes[size] != '>');
+		for (uint64_t i(0); ok && i < size; ++i){
+			checksum = (checksum ^ (uint8_t) bytes[i]) * 1099511628211ULL;
+		}
+	}
+	fclose(file);
+	return ok;
+}
+
+/* Extends the FNV-1a checksum with the bytes from offset begin to
+ * offset end of file fname, false if the file is shorter */
+static bool
+prefixChecksum(const string & fname, uint64_t begin, uint64_t end, uint64_t & checksum)
+{
+	FILE * file = fopen(fname.c_str(), "rb");
+	if (file == NULL){
+		return false;
+	}
+	vector<char> bytes(1 << 20);
+	bool ok = fseek(file, (long) begin, SEEK_SET) == 0;
+	for (uint64_t pos(begin); ok && pos < end; ){
+		size_t size = (size_t) min((uint64_t) bytes.size(), end - pos);
+		ok = fread(&bytes[0], 1, size, file) == size;
+		for (size_t i(0); ok && i < size; ++i){
+			checksum = (checksum ^ (uint8_t) bytes[i]) * 1099511628211ULL;
+		}
+		pos += size;
+	}
+	fclose(file);
+	return ok;
+}
+
+/* Counts of the first pass of readStream, saved in the state file */
+struct StreamCounts {
+	vector<int>     count;  /**< Number of occurences of each byte in each column (size = ncol * 256) */
+	vector<uint8_t> types;  /**< Bytes of each column in order of appearance (size = ncol * 256) */
+	vector<int>     ntype;  /**< Number of different bytes in each column */
+};
+
+/* Reads the counts of state file state_name if it is valid for
+ * the input fname, nseq and ncol are the size of the counts */
+static bool
+readState(const string & state_name, const string & fname, StateHeader & header, StreamCounts & raw)
+{
+	FILE * file = fopen(state_name.c_str(), "rb");
+	if (file == NULL){
+		return false;
+	}
+	uint64_t checksum;
+	bool ok = fread(&header, sizeof(header), 1, file) == 1
+	       && memcmp(header.magic, "MSTXINC", 8) == 0
+	       && header.version == 3
+	       && header.order == 0x01020304
+	       && header.nseq > 0 && header.ncol >= 0
+	       && stateChecksum(fname, header.offset, checksum)
+	       && checksum == header.checksum;
+	if (ok){
+		raw.count.assign((size_t) header.ncol * 256, 0);
+		raw.types.assign((size_t) header.ncol * 256, 0);
+		raw.ntype.assign(header.ncol, 0);
+		for (int col(0); col < header.ncol && ok; ++col){
+			uint16_t ntype;
+			int32_t count[256];
+			uint8_t * types = &raw.types[(size_t) col * 256];
+			ok = fread(&ntype, sizeof(ntype), 1, file) == 1 && ntype <= 256
+			  && fread(types, 1, ntype, file) == ntype
+			  && fread(count, sizeof(int32_t), ntype, file) == ntype;
+			for (int i(0); ok && i < ntype; ++i){
+				raw.count[(size_t) col * 256 + types[i]] = count[i];
+			}
+			raw.ntype[col] = ntype;
+		}
+	}
+	fclose(file);
+	if (!ok){
+		cerr << "Warning: the state file " << state_name << " does not match " << fname << ", all the sequences are read\n";
+		raw = StreamCounts();
+	}
+	return ok;
+}
+
+/* The state is written in a temporary file renamed at the end, so an
+ * interrupted run leaves the previous state. full_checksum is the
+ * checksum of the bytes before offset */
+static void
+writeState(const string & state_name, const string & fname, size_t offset, uint64_t full_checksum, int nseq, int ncol, const StreamCounts & raw)
+{
+	StateHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, "MSTXINC", 8);
+	header.version = 3;
+	header.order = 0x01020304;
+	header.offset = offset;
+	header.full_checksum = full_checksum;
+	header.nseq = nseq;
+	header.ncol = ncol;
+	string tmp_name = state_name + ".tmp";
+	FILE * file = NULL;
+	if (!stateChecksum(fname, offset, header.checksum) || (file = fopen(tmp_name.c_str(), "wb")) == NULL){
+		cerr << "Cannot write the state file " << state_name << "\n";
+		return;
+	}
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	for (int col(0); col < ncol && ok; ++col){
+		uint16_t ntype = (uint16_t) raw.ntype[col];
+		const uint8_t * types = &raw.types[(size_t) col * 256];
+		int32_t count[256];
+		for (int i(0); i < ntype; ++i){
+			count[i] = raw.count[(size_t) col * 256 + types[i]];
+		}
+		ok = fwrite(&ntype, sizeof(ntype), 1, file) == 1
+		  && fwrite(types, 1, ntype, file) == ntype
+		  && fwrite(count, sizeof(int32_t), ntype, file) == ntype;
+	}
+	ok = (fclose(file) == 0) && ok;
+	if (!ok || rename(tmp_name.c_str(), state_name.c_str()) != 0){
+		remove(tmp_name.c_str());
+		cerr << "Cannot write the state file " << state_name << "\n";
+	}
+}
+
+
+/**************************************************************
+ * readStream(fname) reads the alignment by blocks of
+ * sequences, so the memory used depends on the block size
+ * and on the number of columns only.
+ * This pass counts the symbols of each column. A second pass
+ * (readWeights), run only if a statistic needs them,
+ * calculates the weights of the sequences.
+ * The results are the same as when reading the whole file.
+ * In incremental mode (-I), the counts of the sequences read
+ * by the previous run are loaded from the state file, only the
+ * sequences appended since are read, and the state is saved.
+ **************************************************************/
+void
+Msa :: readStream(string fname)
+{
+	ScopedTimer timer("readStream");
+	int max_seq = Context::Get().nb_seq > 0 ? Context::Get().nb_seq : -1;
+	int block = Context::Get().block_size > 0 ? Context::Get().block_size : 1;
+	const string & state_name = Context::Get().state_fname;
+	FastaStream file(fname);
+	vector<uint8_t> rows, cols;
+	StreamCounts raw;
+	if (!state_name.empty() && file.isCompressed()){
+		cerr << "error : the incremental mode (-I) cannot go on in the compressed file " << fname << "\n";
+		exit(0);
+	}
+	if (!file.isRegular()){
+		/* The weights of the sequences need a second pass over the file */
+		cerr << "error : the stream mode (-S) reads the file twice, " << fname << " must be a regular file (not a pipe)\n";
+		exit(0);
+	}
 	
+	streamed = true;
+	stream_fname = fname;
+	nseq = 0;
+	ncol = -1;
 	
-	/* Print if verbose mode */
-	if (Options::Get().verbose){
-		cout << "\nAlphabet :\n";
-	  for(int i(0); i < (int) alphabet.size(); ++i){
-			cout << alphabet[i] << ";";
+	StateHeader state;
+	size_t start = 0;
+	if (!state_name.empty() && readState(state_name, fname, state, raw)){
+		nseq = state.nseq;
+		ncol = state.ncol;
+		start = state.offset;
+		file.seek(start);
+		state_offset = state.offset;
+		state_checksum = state.full_checksum;
+		if (printMessages()){
+			cout << "\nIncremental mode : " << nseq << " sequences counted in " << state_name << "\n";
 		}
-		cout << "\n";
-		cout << "\nMultiple Alignment :\n";
-	  for(int i(0); i <nseq; ++i){
-			cout << mali_seq[i] << "\n";
+		cerr << "Warning: the sequences counted in " << state_name << " are checked on samples of " << fname
+		     << " only, the statistics using the sequence weights check all of them\n";
+	}
+	
+	/* Count the symbols of each column */
+	int nrow;
+	while ((nrow = readBlock(file, (max_seq < 0 || max_seq - nseq > block) ? block : max_seq - nseq, rows, cols)) > 0){
+		if (raw.count.empty()){
+			raw.count.assign((size_t) ncol * 256, 0);
+			raw.types.assign((size_t) ncol * 256, 0);
+			raw.ntype.assign(ncol, 0);
+			/* The number of sequences is projected from the size of the first block */
+			size_t read = file.tell();
+			double nseq_est = read ? (double) nrow * file.getSize() / read : nrow;
+			if (nseq_est < nrow){
+				nseq_est = nrow;
+			}
+			if (max_seq > 0 && nseq_est > max_seq){
+				nseq_est = max_seq;
+			}
+			if (printMessages()){
+				printEstimate(nseq_est, ncol, 8);
+			}
 		}
-		cout << "\nAA Frequencies :\n";
-		for (int i(0); i < (int) aa_freq.size(); ++i){
-			cout << aa_freq[i] << ";";
+		parallelFor(0, ncol, [&](int first, int last){
+			for (int col(first); col < last; ++col){
+				const uint8_t * column = &cols[(size_t) col * nrow];
+				int * count = &raw.count[(size_t) col * 256];
+				for (int row(0); row < nrow; ++row){
+					if (count[column[row]]++ == 0){
+						raw.types[(size_t) col * 256 + raw.ntype[col]++] = column[row];
+					}
+				}
+			}
+		});
+		nseq += nrow;
+	}
+	if (ncol < 0){
+		ncol = 0;
+	}
+	Profile::addBytes("input", file.tell() - start);
+	if (!state_name.empty() && nseq > 0){
+		/* Only the bytes appended since the state are added to its checksum */
+		uint64_t full_checksum = state_offset ? state_checksum : FNV_BASIS;
+		if (prefixChecksum(fname, start, file.nextOffset(), full_checksum)){
+			writeState(state_name, fname, file.nextOffset(), full_checksum, nseq, ncol, raw);
+		} else {
+			cerr << "Cannot write the state file " << state_name << "\n";
 		}
-		cout << "\n";
-		cout << "\nGap counts :\n";
-		for (int i(0); i < (int) gap_counts.size(); ++i){
-			cout << gap_counts[i] << ";";
+	}
+	if (max_seq > 0 && nseq >= max_seq){
+		string name;
+		vector<uint8_t> residues;
+		if (file.nextRecord(name, residues)){
+			cerr << "Warning: only the first " << max_seq << " sequences of " << fname << " are read (option -n)\n";
 		}
-		cout << "\n";
-		cout << "\nAA Entropy :\n";
-		for (int i(0); i < (int) entropy.size(); ++i){
-			if (gap_counts[i] < nseq/10){
-		  	cout << entropy[i] << ";";
-			} else {
-				cout << "-12.0;";
+	}
+	if (printMessages()){
+		cout << "\nMultiple alignment : nb seq = "<<nseq<<", nb col = "<<ncol<<" (stream mode)\n";
+	}
+	
+	/* Define the alphabet in the same order as defineAlphabet */
+	alphabet.clear();
+	for (int c(0); c < 256; ++c){
+		alphabet_pos[c] = -1;
+	}
+	for (int col(0); col < ncol; ++col){
+		for (int i(0); i < raw.ntype[col]; ++i){
+			uint8_t c = raw.types[(size_t) col * 256 + i];
+			if (alphabet_pos[c] < 0){
+				alphabet_pos[c] = (int) alphabet.size();
+				alphabet.push_back(c);
 			}
 		}
-		cout << "\n";
-		cout << "\nAA Types :\n";
-		for (int i(0); i < (int) nb_type.size(); ++i){
-				cout << nb_type[i] << ";";
+	}
+	int K = (int) alphabet.size();
+	sym_count.assign((size_t) ncol * K, 0);
+	type_list.assign((size_t) ncol * K, 0);
+	nb_type.assign(ncol, 0);
+	for (int col(0); col < ncol; ++col){
+		for (int i(0); i < raw.ntype[col]; ++i){
+			uint8_t c = raw.types[(size_t) col * 256 + i];
+			sym_count[(size_t) col * K + alphabet_pos[c]] = raw.count[(size_t) col * 256 + c];
+			type_list[(size_t) col * K + i] = (uint8_t) alphabet_pos[c];
 		}
-		cout << "\n";
+		nb_type[col] = raw.ntype[col];
 	}
+	countGap();
+	countFreq();
+	countEntropy();
+}
+
+
+/**************************************************************
+ * readWeights() reads again the sequences of the stream mode
+ * by blocks, calculates the weight of each sequence from the
+ * counts and sums them in the weighted counts.
+ * The weight of a sequence depends on the counts of all the
+ * sequences, so all the sequences are read, also in
+ * incremental mode: the bytes counted in the state file are
+ * then checked against its checksum of all of them.
+ **************************************************************/
+void
+Msa :: readWeights()
+{
+	ScopedTimer timer("readWeights");
+	int block = Context::Get().block_size > 0 ? Context::Get().block_size : 1;
+	int K = (int) alphabet.size();
+	if (state_offset > 0){
+		uint64_t checksum = FNV_BASIS;
+		if (!prefixChecksum(stream_fname, 0, state_offset, checksum) || checksum != state_checksum){
+			cerr << "error : the sequences counted in the state file " << Context::Get().state_fname << " changed in "
+			     << stream_fname << ", remove the state file to count them again\n";
+			exit(0);
+		}
+	}
+	FastaStream file(stream_fname);
+	vector<uint8_t> rows, cols;
+	vector<float> w;
+	seq_weight.clear();
+	weighted_count.assign((size_t) ncol * K, 0.0);
+	int done = 0;
+	int nrow;
+	while (done < nseq && (nrow = readBlock(file, (nseq - done > block) ? block : nseq - done, rows, cols)) > 0){
+		for (size_t i(0); i < cols.size(); ++i){
+			cols[i] = (uint8_t) alphabet_pos[cols[i]];
+		}
+		w.assign(nrow, 0.0);
+		parallelFor(0, nrow, [&](int first, int last){
+			for (int x(0); x < ncol; ++x){
+				const uint8_t * column = &cols[(size_t) x * nrow];
+				const int * n = getCount(x);
+				int k = nb_type[x];
+				for (int seq(first); seq < last; ++seq){
+					w[seq] += (float) 1 / (float) (n[column[seq]] * k);
+				}
+			}
+			for (int seq(first); seq < last; ++seq){
+				w[seq] /= (float) ncol;
+			}
+		});
+		parallelFor(0, ncol, [&](int first, int last){
+			for (int x(first); x < last; ++x){
+				const uint8_t * column = &cols[(size_t) x * nrow];
+				float * p = &weighted_count[(size_t) x * K];
+				for (int seq(0); seq < nrow; ++seq){
+					p[column[seq]] += w[seq];
+				}
+			}
+		});
+		seq_weight.insert(seq_weight.end(), w.begin(), w.end());
+		done += nrow;
+	}
+	if (done != nseq){
+		cerr << "error : " << stream_fname << " changed while it was read, " << done << " sequences read again instead of " << nseq << "\n";
+		exit(0);
+	}
+	Profile::addBytes("input", file.tell());
+}
+
+
+/**************************************************************
+ * printEstimate(nseq, ncol, bits) prints the memory needed to
+ * analyse an alignment of nseq sequences and ncol columns
+ * of bits bits per symbol, and the size of the run.
+ * K = 32 symbols is assumed for the counts.
+ * The mapped input file is not counted (it is paged by the
+ * system).
+ **************************************************************/
+void
+Msa :: printEstimate(double nseq, int ncol, int bits) const
+{
+	const double K = 32;
+	double bytes;
+	if (Context::Get().stream){
+		double block = Context::Get().block_size;
+		bytes = 2 * block * ncol                 /* block of sequences and its transposition */
+		      + ncol * 256.0 * 5                 /* counts of the first pass */
+		      + ncol * K * 9                     /* counts, types and weighted counts */
+		      + nseq * 4;                        /* weights */
+	} else {
+		bytes = nseq * ncol * bits / 8           /* column-major alignment */
+		      + nseq * (4 + 40)                  /* weights and names */
+		      + ncol * K * 9                     /* counts, types and weighted counts */
+		      + nbThreads() * 64.0 * ncol;       /* blocks of rows being transposed */
+	}
+	double cells = nseq * ncol;
+	string size;
+	if (cells < 1e8){
+		size = "small (seconds)";
+	} else if (cells < 1e10){
+		size = "medium (minutes)";
+	} else {
+		size = "large (hours, see options -p and -S)";
+	}
+	cout << "Projected memory: " << setprecision(3) << bytes / (1024 * 1024) << " MB, "
+	     << cells << " residues, " << size << "\n" << setprecision(6);
+}
+
+
+/**************************************************************
+ * analyse() runs all the counts on the encoded alignment.
+ * The symbols are counted once by countType(), the other
+ * counts are derived from this table.
+ **************************************************************/
+void
+Msa :: analyse(){
+	gap_counts.clear();
+	nb_type.clear();
+	seq_weight.clear();
+	weighted_count.clear();
+	countType();
+	countGap();
+	countFreq();
+	countEntropy();
 }
 
 
@@ -133,14 +1193,16 @@ Msa :: Msa(string fname)
  **************************************************************/
 void
 Msa :: countGap(){
+	ScopedTimer timer("countGap");
 	for(int col(0); col < ncol; ++col){
-		int gap = 0;
-		for(int row(0); row < nseq; ++row){
-			if (mali_seq[row][col] == '-' || mali_seq[row][col] == ' '){
-				gap++;
+		const int * count = getCount(col);
+		int nb_gap = 0;
+		for (int a(0); a < (int) alphabet.size(); ++a){
+			if (isGap(a)){
+				nb_gap += count[a];
 			}
 		}
-		gap_counts.push_back(gap);
+		gap_counts.push_back(nb_gap);
 	}
 }
 
@@ -148,71 +1210,155 @@ Msa :: countGap(){
 /**************************************************************
  * countFreq() calculates the frequency of each amino acid
  * type in the overall multiple alignment
+ * The counts of blocks of columns are summed by the threads
+ * in 64 bits (no overflow on huge alignments), then the blocks
+ * are added in order.
  **************************************************************/
 void
 Msa :: countFreq(){
-	int total = 0;
-	vector<int> tmp_freq(alphabet.size(), 0);
+	ScopedTimer timer("countFreq");
+	int K = (int) alphabet.size();
+	int nblock = (ncol + 255) / 256;
+	vector<int64_t> partial((size_t) nblock * (K + 1), 0);
 	
-	aa_freq = vector<float>(alphabet.size());
-	/* Count the number of each amino acid type defined in alphabet */
-	for(int col(0); col < ncol; ++col){
-		for(int row(0); row < nseq; ++row){
-			if (mali_seq[row][col] != '-' && mali_seq[row][col] != ' '){
-				total++;
-			}
-			int pos = (int) alphabet.find(mali_seq[row][col]);
-			if (pos >= (int) alphabet.size()){
-			  cerr << "error : symbol is not in the alphabet\n";
-				exit(0);
+	/* Count the number of each amino acid type defined in alphabet (and the residues in partial[K]) */
+	parallelFor(0, nblock, [&](int first, int last){
+		for (int b(first); b < last; ++b){
+			int64_t * sum = &partial[(size_t) b * (K + 1)];
+			for (int col(b * 256); col < min(ncol, (b + 1) * 256); ++col){
+				const int * count = getCount(col);
+				for (int a(0); a < K; ++a){
+					sum[a] += count[a];
+				}
+				sum[K] += nseq - gap_counts[col];
 			}
-			tmp_freq[pos]++;
+		}
+	});
+	vector<int64_t> tmp_freq(K + 1, 0);
+	for (int b(0); b < nblock; ++b){
+		for (int a(0); a <= K; ++a){
+			tmp_freq[a] += partial[(size_t) b * (K + 1) + a];
 		}
 	}
 
 	/* Divide by the total */
-	for (int i(0); i < (int) aa_freq.size(); ++i){
-		aa_freq[i] = (float) tmp_freq[i] ;
-		aa_freq[i] /= (float) total;
+	aa_freq = vector<float>(K);
+	for (int i(0); i < K; ++i){
+		aa_freq[i] = (float) ((double) tmp_freq[i] / (double) tmp_freq[K]);
 	}
 }
 
+
 /**************************************************************
- * countType() calculates the number of different types in
- * each column of the alignment
+ * countColumn<KMAX>(column, nseq, K, count, types) counts the
+ * symbols of a column of nseq symbols of an alphabet of K <= KMAX
+ * symbols, and lists in types the symbols present in order of
+ * first appearance. Returns the number of types.
+ * The rows are counted in 4 tables, so consecutive equal symbols
+ * (conserved columns) do not wait for each other.
  **************************************************************/
-void
-Msa :: countType(){
-	string aa_types;
-	for(int col(0); col < ncol; ++col){
-		aa_types.clear();
-		for(int row(0); row < nseq; ++row){
-			if (aa_types.find(mali_seq[row][col]) >= aa_types.size()){
-			  aa_types.push_back(mali_seq[row][col]);
-			}
+template <int KMAX>
+static int
+countColumn(const uint8_t * column, int nseq, int K, int * count, uint8_t * types)
+{
+	int hist[4][KMAX] = {};
+	int row(0);
+	for (; row + 4 <= nseq; row += 4){
+		hist[0][column[row]]++;
+		hist[1][column[row + 1]]++;
+		hist[2][column[row + 2]]++;
+		hist[3][column[row + 3]]++;
+	}
+	for (; row < nseq; ++row){
+		hist[0][column[row]]++;
+	}
+	int ntype_all = 0;
+	for (int a(0); a < K; ++a){
+		count[a] = hist[0][a] + hist[1][a] + hist[2][a] + hist[3][a];
+		ntype_all += count[a] > 0;
+	}
+	/* The types usually all appear in the first rows */
+	bool seen[KMAX] = {};
+	int ntype = 0;
+	for (row = 0; ntype < ntype_all; ++row){
+		if (!seen[column[row]]){
+			seen[column[row]] = true;
+			types[ntype++] = column[row];
 		}
-		aa_type_list.push_back(aa_types);
-		nb_type.push_back((int) aa_types.size());
 	}
+	return ntype;
 }
 
+
 /**************************************************************
- * defineAlphabet() reads the multiple alignment to
- * determine all the symbols used in
+ * countPacked(planes, nseq, nword, nbits, K, count, types)
+ * counts the symbols of a packed column with one popcount
+ * per symbol and word, and lists in types the symbols present
+ * in order of first appearance. Returns the number of types.
  **************************************************************/
-void
-Msa :: defineAlphabet(){
-	alphabet.clear();
-	for(int col(0); col < ncol; ++col){
-		for(int row(0); row < nseq; ++row){
-			if (alphabet.find(mali_seq[row][col]) >= alphabet.size()){
-				alphabet.push_back(mali_seq[row][col]);
+static int
+countPacked(const uint64_t * planes, int nseq, int nword, int nbits, int K, int * count, uint8_t * types)
+{
+	uint64_t mask[16];
+	int first[16];
+	for (int a(0); a < K; ++a){
+		first[a] = -1;
+	}
+	for (int w(0); w < nword; ++w){
+		splitSymbols(planes, nbits, nword, w, validRows(nseq, w), mask);
+		for (int a(0); a < K; ++a){
+			if (mask[a]){
+				count[a] += __builtin_popcountll(mask[a]);
+				if (first[a] < 0){
+					first[a] = w * 64 + __builtin_ctzll(mask[a]);
+				}
 			}
 		}
 	}
+	vector<pair<int,int> > order;
+	for (int a(0); a < K; ++a){
+		if (first[a] >= 0){
+			order.push_back(make_pair(first[a], a));
+		}
+	}
+	sort(order.begin(), order.end());
+	for (size_t i(0); i < order.size(); ++i){
+		types[i] = (uint8_t) order[i].second;
+	}
+	return (int) order.size();
 }
 
 
+/**************************************************************
+ * countType() counts the occurences of each symbol in each
+ * column of the alignment (sym_count) in a single pass.
+ * The different types of a column are stored in type_list
+ * in their order of appearance in the column.
+ **************************************************************/
+void
+Msa :: countType(){
+	ScopedTimer timer("countType");
+	int K = (int) alphabet.size();
+	sym_count.assign((size_t) ncol * K, 0);
+	type_list.assign((size_t) ncol * K, 0);
+	nb_type.assign(ncol, 0);
+	if (col_bits){
+		parallelFor(0, ncol, [&](int first, int last){
+			for(int col(first); col < last; ++col){
+				nb_type[col] = countPacked(getPlanes(col), nseq, nword, col_bits, K, &sym_count[(size_t) col * K], &type_list[(size_t) col * K]);
+			}
+		});
+		return;
+	}
+	dispatchAlphabet(K, [&](auto kmax){
+		parallelFor(0, ncol, [&](int first, int last){
+			for(int col(first); col < last; ++col){
+				nb_type[col] = countColumn<decltype(kmax)::value>(&col_data[(size_t) col * nseq], nseq, K, &sym_count[(size_t) col * K], &type_list[(size_t) col * K]);
+			}
+		});
+	});
+}
+
 /**************************************************************
  * getFreq(aa) returns the frequency of amino acid aa
  * in the overall multiple alignment
@@ -228,18 +1374,6 @@ Msa :: getFreq(char aa){
 }
 
 
-/**************************************************************
- * getAaPos(aa) returns the index of aa in alphabet
- **************************************************************/
-int
-Msa :: getAaPos(char aa){
-	if (alphabet.find(aa) >= alphabet.size()){
-		return -1;
-	}
-	return (int) alphabet.find(aa);
-};
-
-
 /**************************************************************
  * getGap(col) returns the number of gap in column col
  **************************************************************/
@@ -257,28 +1391,154 @@ Msa :: getGap(int col){
  * K = alphabet length
  * p_a = probability to see amino acid of type a in the column
  * p_a = frequency of amino acid a in the column (nb_a / nseq)
+ * The terms are added by a compensated sum (see reduce.h).
  **************************************************************/
 void 
 Msa :: countEntropy(){
+	ScopedTimer timer("countEntropy");
 	entropy = vector<float>(ncol,0.0);
  
-  for(int col(0); col < ncol; ++col){
-		vector<float> lfreq(alphabet.size(), 0.0);
-		for(int row(0); row < nseq; ++row){
-			lfreq[getAaPos(mali_seq[row][col])] += 1.0;
-		}
-		for (int i(0); i < (int) lfreq.size(); ++i){
-		  lfreq[i] /= (float) nseq;
-			if (lfreq[i] > 0.0){
-				if (lfreq[i] == 1.0){
-				  entropy[col] = 0.0;	
-				} else {
-				  entropy[col] -= lfreq[i] * log(lfreq[i]);	
+	parallelFor(0, ncol, [&](int first, int last){
+		for(int col(first); col < last; ++col){
+			const int * count = getCount(col);
+			KahanSum sum;
+			for (int i(0); i < (int) alphabet.size(); ++i){
+				if (count[i] > 0 && count[i] < nseq){
+					double lfreq = (double) count[i] / (double) nseq;
+					sum.add(-lfreq * log(lfreq));
+				}
+			}
+			entropy[col] = (float) (sum.get() / log((double) alphabet.size() - 1)); /* -1 because gaps are in the alphabet */
+		}
+	});
+}
+
+
+/**************************************************************
+ * calcSeqWeight() calculates the weight of each sequence
+ * by the formula from Henikoff & Henikoff (1994)
+ * w_i = \frac{1}{L}\sum_{x=1}^{L}\frac{1}{k_x n_{x_i}} (LateX code)
+ * For each column, the occurences of each symbol are counted
+ * once, so all the weights are obtained in a single O(N.L)
+ * sweep over the alignment.
+ * For packed columns, the rows of each symbol are taken from
+ * the bit planes, 64 sequences at a time.
+ **************************************************************/
+void
+Msa :: calcSeqWeight(){
+	ScopedTimer timer("calcSeqWeight");
+	seq_weight = vector<float>(nseq, 0.0);
+	/* Threads share the sequences, each weight is summed over the columns in order */
+	if (col_bits){
+		parallelFor(0, nword, [&](int first, int last){
+			uint64_t mask[16];
+			for (int x(0); x < ncol; ++x){
+				const int * n = getCount(x);
+				int k = nb_type[x];
+				for (int w(first); w < last; ++w){
+					splitSymbols(getPlanes(x), col_bits, nword, w, validRows(nseq, w), mask);
+					float * sw = &seq_weight[(size_t) w * 64];
+					for (int a(0); a < (int) alphabet.size(); ++a){
+						if (mask[a]){
+							float inc = (float) 1 / (float) (n[a] * k);
+							for (uint64_t m(mask[a]); m; m &= m - 1){
+								sw[__builtin_ctzll(m)] += inc;
+							}
+						}
+					}
+				}
+			}
+			for (int seq(first * 64); seq < min(nseq, last * 64); ++seq){
+				seq_weight[seq] /= (float) ncol;
+			}
+		});
+		return;
+	}
+	parallelFor(0, nseq, [&](int first, int last){
+		for (int x(0); x < ncol; ++x){
+			const uint8_t * column = &col_data[(size_t) x * nseq];
+			const int * n = getCount(x); /**< number of occurences of each symbol in the column */
+			int k = nb_type[x];
+			for (int seq(first); seq < last; ++seq){
+				seq_weight[seq] += (float) 1 / (float) (n[column[seq]] * k);
+			}
+		}
+		for (int seq(first); seq < last; ++seq){
+			seq_weight[seq] /= (float) ncol;
+		}
+	});
+}
+
+
+/**************************************************************
+ * getSeqWeight() returns the weight of each sequence,
+ * the weights are calculated at the first call only
+ **************************************************************/
+const vector<float> &
+Msa :: getSeqWeight(){
+	if ((int) seq_weight.size() != nseq){
+		if (streamed){
+			readWeights();
+		} else {
+			calcSeqWeight();
+		}
+	}
+	return seq_weight;
+}
+
+
+/**************************************************************
+ * calcWeightedCount() sums the weights of the sequences
+ * having each symbol in each column. This is the weighted
+ * probability p_a of Henikoff used by wentropy, trident and
+ * jensen.
+ **************************************************************/
+void
+Msa :: calcWeightedCount(){
+	ScopedTimer timer("calcWeightedCount");
+	int K = (int) alphabet.size();
+	const vector<float> & w = getSeqWeight();
+	weighted_count.assign((size_t) ncol * K, 0.0);
+	parallelFor(0, ncol, [&](int first, int last){
+		uint64_t mask[16];
+		for (int x(first); x < last; ++x){
+			float * p = &weighted_count[(size_t) x * K];
+			if (col_bits){
+				/* The weights of each symbol are still summed in the order of the sequences */
+				for (int wd(0); wd < nword; ++wd){
+					splitSymbols(getPlanes(x), col_bits, nword, wd, validRows(nseq, wd), mask);
+					const float * sw = &w[(size_t) wd * 64];
+					for (int a(0); a < K; ++a){
+						for (uint64_t m(mask[a]); m; m &= m - 1){
+							p[a] += sw[__builtin_ctzll(m)];
+						}
+					}
 				}
+				continue;
 			}
+			const uint8_t * column = &col_data[(size_t) x * nseq];
+			for (int seq(0); seq < nseq; ++seq){
+				p[column[seq]] += w[seq];
+			}
+		}
+	});
+}
+
+
+/**************************************************************
+ * getWeightedCount(col) returns the weighted count of each
+ * symbol in column col, calculated at the first call only
+ **************************************************************/
+const float *
+Msa :: getWeightedCount(int col){
+	if (weighted_count.size() != (size_t) ncol * alphabet.size()){
+		if (streamed){
+			readWeights();
+		} else {
+			calcWeightedCount();
 		}
-		entropy[col] /= log(alphabet.size()-1); /* -1 because gaps are in the alphabet */
 	}
+	return weighted_count.data() + (size_t) col * alphabet.size();	/* no element to bind to without columns */
 }
 
 
@@ -296,40 +1556,138 @@ Msa :: isInclude(string alph1){
 	return true;
 }
 
+/**************************************************************
+ * getTypeList(col) returns the different symbols of column
+ * col in their order of appearance
+ **************************************************************/
+string
+Msa :: getTypeList(int col)
+{
+	string types;
+	Span<uint8_t> pos = getTypes(col);
+	for (size_t i(0); i < pos.size(); ++i){
+		types.push_back(alphabet[pos[i]]);
+	}
+	return types;
+}
+
 string 
 Msa :: getCol(int col)
 {
   string column;
+	Scratch scratch;
+	const uint8_t * pos = getColumn(col, scratch.get<uint8_t>(nseq));
 	for (int i(0); i < nseq; ++i){
-		column.push_back(mali_seq[i][col]);
+		column.push_back(alphabet[pos[i]]);
 	}
 	return column;
 }
 
 
+/**************************************************************
+ * getColumn(col, buf) returns the positions in alphabet of
+ * the nseq symbols of column col. Packed columns are unpacked
+ * in buf (nseq bytes), otherwise buf is not used.
+ **************************************************************/
+const uint8_t *
+Msa :: getColumn(int col, uint8_t * buf) const
+{
+	if (!col_bits){
+		return &col_data[(size_t) col * nseq];
+	}
+	uint64_t mask[16];
+	for (int w(0); w < nword; ++w){
+		splitSymbols(getPlanes(col), col_bits, nword, w, validRows(nseq, w), mask);
+		uint8_t * out = buf + (size_t) w * 64;
+		for (int a(0); a < (int) alphabet.size(); ++a){
+			for (uint64_t m(mask[a]); m; m &= m - 1){
+				out[__builtin_ctzll(m)] = (uint8_t) a;
+			}
+		}
+	}
+	return buf;
+}
+
+
+/** getSymbol(seq, col) returns the symbol row seq, column col */
+char
+Msa :: getSymbol(int seq, int col)
+{
+	if (!col_bits){
+		return alphabet[col_data[(size_t) col * nseq + seq]];
+	}
+	const uint64_t * planes = getPlanes(col);
+	int pos = 0;
+	for (int b(0); b < col_bits; ++b){
+		pos |= (int) ((planes[(size_t) b * nword + seq / 64] >> (seq % 64)) & 1) << b;
+	}
+	return alphabet[pos];
+}
+
+
 /**************************************************************
  * fitToAlphabet(string alph1) transforms symbols 
- * if a symbol from msa is not in alph1 then it is a gap
+ * if a symbol from msa is not in alph1 then it is a gap.
+ * The removed symbols are erased from the alphabet, the
+ * alignment is encoded again and analysed
  **************************************************************/
 void
 Msa :: fitToAlphabet(string alph1){
-	int alph_size = (int) alph1.size();
-	for (int i(0); i < nseq; i++){
-		for (int j(0); j < ncol; j++){
-			if (mali_seq[i][j] != '-' && mali_seq[i][j] != ' ' && (int) alph1.find(mali_seq[i][j]) >= alph_size){
-				int k = (int) alphabet.find(mali_seq[i][j]);
-				if (k < (int) alphabet.size()){
-					alphabet.erase(alphabet.begin() + k);
+	if (streamed){
+		cerr << "error : the symbols of the alignment cannot be changed in stream mode\n";
+		exit(0);
+	}
+	string new_alphabet;
+	vector<int> new_pos(alphabet.size(), -1);
+	for (int a(0); a < (int) alphabet.size(); ++a){
+		if (isGap(a) || alph1.find(alphabet[a]) < alph1.size()){
+			new_pos[a] = (int) new_alphabet.size();
+			new_alphabet.push_back(alphabet[a]);
+		}
+	}
+	if (new_alphabet.size() == alphabet.size()){
+		return;
+	}
+	int gap = (int) new_alphabet.find('-');
+	if (gap < 0){
+		gap = (int) new_alphabet.size();
+		new_alphabet.push_back('-');
+	}
+	for (int a(0); a < (int) alphabet.size(); ++a){
+		if (new_pos[a] < 0){
+			new_pos[a] = gap;
+		}
+	}
+	
+	ownColumns();
+	if (col_bits){
+		/* The new alphabet is not larger, the columns are packed on the same bits */
+		parallelFor(0, ncol, [&](int first, int last){
+			Scratch scratch;
+			uint8_t * buf = scratch.get<uint8_t>((size_t) nword * 64);
+			for (int col(first); col < last; ++col){
+				uint64_t * planes = &mali_bits[(size_t) col * col_bits * nword];
+				getColumn(col, buf);
+				for (int i(0); i < nseq; ++i){
+					buf[i] = (uint8_t) new_pos[buf[i]];
 				}
-				int pos = (int) aa_type_list[j].find(mali_seq[i][j]);
-				if (pos < (int) aa_type_list[j].size()){
-					aa_type_list[j].erase(aa_type_list[j].begin() + pos);
-					nb_type[j]--;
+				for (int w(0); w < nword; ++w){
+					packBlock(&buf[(size_t) w * 64], min(64, nseq - w * 64), col_bits, planes + w, nword);
 				}
-				mali_seq[i][j] = '-';
 			}
-		}
+		});
+	}
+	for (size_t i(0); i < mali_col.size(); ++i){
+		mali_col[i] = (uint8_t) new_pos[mali_col[i]];
 	}
+	alphabet = new_alphabet;
+	for (int c(0); c < 256; ++c){
+		alphabet_pos[c] = -1;
+	}
+	for (int a(0); a < (int) alphabet.size(); ++a){
+		alphabet_pos[(unsigned char) alphabet[a]] = a;
+	}
+	analyse();
 }
 
 
@@ -341,7 +1699,7 @@ void
 Msa :: printBasic(){
 	string dictionary = "ARNDCQEGHILKMFPSTWYV-";
 	vector<int> counts(dictionary.size(), 0);
-	string out_name = Options::Get().output_fname;
+	string out_name = Context::Get().output_fname;
 	out_name = out_name.substr(0,out_name.find('.')) + ".aa_count";
 	ofstream file(out_name.c_str());
 	if (!file.is_open()){
@@ -353,12 +1711,13 @@ Msa :: printBasic(){
 	}
 	file << "\n";
 	for (int col(0); col < ncol; col++){
-		for (int seq(0); seq < nseq; seq++){
-			int pos = (int) dictionary.find(mali_seq[seq][col]);
-			if (pos < (int) dictionary.size()){
-				counts[pos]++;
-			} else {
-				cerr << mali_seq[seq][col] << " is not in the dictionary\n";
+		const int * count = getCount(col);
+		for (int b(0); b < (int) alphabet.size(); b++){
+			size_t pos = dictionary.find(alphabet[b]);
+			if (pos < dictionary.size()){
+				counts[pos] += count[b];
+			} else if (count[b] > 0){
+				cerr << alphabet[b] << " is not in the dictionary\n";
 			}
 		}
 		for (int a(0); a < (int) dictionary.size(); a++) {
@@ -369,4 +1728,3 @@ Msa :: printBasic(){
 	}
 	file.close();
 }
-
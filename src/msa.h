@@ -24,6 +24,12 @@
 
 #include <vector>
 #include <string>
+#include <memory>
+#include <stdint.h>
+
+#include "fasta.h"
+#include "mapped_file.h"
+#include "span.h"
 
 using namespace std;
 
@@ -31,43 +37,83 @@ class Msa
 {
 protected:
 	string alphabet;
+	int    alphabet_pos[256];			/**< Position of each symbol in alphabet (-1 if absent) */
 	vector<string> mali_name;			/**< Name of sequences of the multiple alignment */
-	vector<string> mali_seq;			/**< Sequences of the multiple alignment */
-	vector<string> aa_type_list;	/**< List of aa type in each column (size = ncol * 20) */
+	vector<uint8_t> mali_col;			/**< Column-major alignment, position in alphabet of symbol (seq, col) is at col * nseq + seq */
+	vector<uint64_t> mali_bits;		/**< Bit-packed alignment (alphabets of at most 16 symbols), see getPlanes */
+	const uint8_t  * col_data;		/**< Columns of mali_col, or of the mapped alignment cache */
+	const uint64_t * bit_data;		/**< Packed columns of mali_bits, or of the mapped alignment cache */
+	unique_ptr<MappedFile> cache;	/**< Alignment cache (fname.msabin) mapped in memory (-M) */
+	vector<int>    sym_count;			/**< Number of occurences of each symbol in each column (size = ncol * alphabet size) */
+	vector<uint8_t> type_list;		/**< Positions of the symbols of each column in order of appearance (size = ncol * alphabet size) */
+	vector<float>  weighted_count;	/**< Sum of the weights of the sequences having each symbol in each column (computed on demand) */
 	vector<int>    gap_counts;		/**< Number of gaps in each column */
 	vector<float>  aa_freq;				/**< Frequency of amino acids types in the overall multiple alignment */
 	vector<float>  entropy;				/**< Entropy of each column of the multiple alignment */
 	vector<int>    nb_type;				/**< Number of amino acid types in the column */
+	vector<float>  seq_weight;		/**< Henikoff weight of each sequence (computed on demand) */
 	
+	int  col_bits;								/**< Number of bits of the packed symbols (0 if the columns are kept as bytes in mali_col) */
+	int  nword;										/**< Number of 64 bits words of a bit plane of a packed column */
+	bool streamed;								/**< True if the alignment was read by blocks (only counts and weights are kept) */
+	string stream_fname;					/**< File read again for the weights in stream mode */
+	uint64_t state_offset;				/**< Bytes of stream_fname counted in the state file (-I), 0 without state */
+	uint64_t state_checksum;			/**< FNV-1a of these bytes saved in the state file, checked again by readWeights */
 	int nseq;											/**< Number of sequences in the multiple alignment */
 	int ncol;											/**< Number of columns in the multiple alignment */
+	int first_col;								/**< Position of the first column in the whole alignment (column range views) */
 	
 	void countGap();							/**< Count the number of gap in each column */
 	void countFreq();							/**< Calculate the frequencies of each amino acid type in the multiple alignment */
-	void countType();							/**< Calculate the number of different amino acid types in each column */
+	void countType();							/**< Count each symbol and the different amino acid types in each column */
 	void countEntropy();					/**< Calculate the entropy of each column in the multiple alignment */
-	void defineAlphabet();				/**< Define the alphabet used in the multiple alignment */
+	void readFile(string fname);	/**< Read the whole alignment in the column-major matrix */
+	void readBuffer(const char * data, size_t size, const string & name);	/**< Read the whole alignment from the size bytes of data */
+	void printVerbose();					/**< Print the alphabet, the alignment and its counts in verbose mode */
+	void readStream(string fname);	/**< Count the symbols by blocks of sequences (from the state file in incremental mode) */
+	void readWeights();						/**< Weight the sequences read again by blocks in stream mode */
+	bool readCache(const string & fname);		/**< Map the encoded alignment and its counts from the cache of fname if it is up to date */
+	void writeCache(const string & fname) const;	/**< Write the encoded alignment and its counts in the cache of fname */
+	void ownColumns();						/**< Copy the columns of the mapped cache in mali_col or mali_bits before changing them */
+	int  readBlock(FastaStream & file, int nrow, vector<uint8_t> & rows, vector<uint8_t> & cols);	/**< Read a block of sequences column by column */
+	void printEstimate(double nseq, int ncol, int bits) const;	/**< Print the projected memory footprint and size of the run */
+	void defineAlphabet(const vector<FastaRecord> & records);	/**< Define the alphabet used in the sequences in order of first appearance in the columns */
+	const uint64_t * getPlanes(int col) const {return &bit_data[(size_t) col * col_bits * nword];};	/**< Returns the col_bits planes of nword words of the packed column col: bit seq of plane b is bit b of symbol (seq, col) */
+	void analyse();								/**< Run all the counts on the encoded alignment */
+	void calcSeqWeight();					/**< Calculate the weight of each sequence (Henikoff & Henikoff) */
+	void calcWeightedCount();			/**< Calculate the weighted count of each symbol in each column */
 	
 public:
 	Msa(string fname);
+	Msa(const char * data, size_t size, string name = "memory");	/**< Reads the alignment from a buffer in memory */
+	Msa(const Msa & parent, const vector<int> & rows, int first, int last);	/**< View of the sequences rows (all if empty) and the columns [first, last[ of parent */
 	~Msa(){};
 	
-	int   getAaPos(char aa);		/**< Converts a char in his position in alphabet */
+	int   getAaPos(char aa) const {return alphabet_pos[(unsigned char) aa];};	/**< Converts a char in his position in alphabet (-1 if absent) */
 	float getFreq(char aa);			/**< Return the frequency of amino acid aa in the overall multiple alignment */
 	int   getGap(int col);			/**< Return the number of gaps in the column col */
-	vector<int> getGapCount(){return gap_counts;};
+	const vector<int> & getGapCount() const {return gap_counts;};
+	const vector<float> & getSeqWeight();	/**< Return the weight of each sequence, calculated once and cached */
+	const int * getCount(int col) const {return &sym_count[(size_t) col * alphabet.size()];};	/**< Returns the number of occurences of each symbol of alphabet in column col */
+	const float * getWeightedCount(int col);	/**< Returns the sum of sequence weights for each symbol of alphabet in column col */
 	
 	int   getNcol() const {return ncol;};									/**< Returns ncol value */
 	int   getNseq() const {return nseq;};									/**< Returns nseq value */
+	int   getFirstCol() const {return first_col;};					/**< Position of column 0 in the whole alignment (0 except for views) */
+	bool  isStreamed() const {return streamed;};						/**< True if the columns are not kept (stream mode) */
 	int   nbGap(int col) const {return gap_counts[col];};	/**< Returns the number of gaps in column col */
 	bool  isInclude(string alph1);												/**< True if the alphabet of the multiple alignment is included in the alphabet alph1 */
 	
 	string getCol(int col);																/**< Returns a column as a string */
-	string getAlphabet() const{return alphabet;};					/**< Returns the alphabet of the msa */
+	const string & getAlphabet() const {return alphabet;};	/**< Returns the alphabet of the msa */
 	
-	char getSymbol(int seq, int col){return mali_seq[seq][col];};	/**< Return symbol row seq, column col */
+	bool  isPacked() const {return col_bits > 0;};								/**< True if the columns are bit-packed */
+	const uint8_t * getColumn(int col, uint8_t * buf) const;	/**< Returns the nseq symbol positions of column col as contiguous bytes (unpacked in buf, of nseq bytes, if the columns are packed) */
+	bool isGap(int pos) const {return alphabet[pos] == '-' || alphabet[pos] == ' ';};	/**< True if the symbol at position pos in alphabet is a gap */
+	char getSymbol(int seq, int col);				/**< Return symbol row seq, column col */
 	int getNtype(int col){return nb_type[col];};									/**< Return the number of different amino acids in the column col */
-	string getTypeList(int col){return aa_type_list[col];};				/**< Return the list of amino acid types in the column col */
+	Span<uint8_t> getTypes(int col) const {return Span<uint8_t>(&type_list[(size_t) col * alphabet.size()], nb_type[col]);};	/**< Returns the positions of the getNtype(col) symbols of column col */
+	string getTypeList(int col);																	/**< Return the list of amino acid types in the column col */
 	
 	void fitToAlphabet(string alph1);																		/**< if a symbol of the msa is not in alphabet alph1, then it is changed in a gap '-' */
 	void printBasic();
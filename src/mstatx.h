@@ -0,0 +1,59 @@
+/* Copyright (c) 2012 Guillaume Collet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __MSTATX_H__
+#define __MSTATX_H__
+
+/*
+ * Public header of libmstatx, the statistics of MstatX embedded in
+ * another program:
+ *
+ *   Context ctx;                       // the defaults of the command line
+ *   ctx.quiet = true;
+ *   ContextScope scope(ctx);           // used by the calls of this thread
+ *   Msa msa(fasta.data(), fasta.size());
+ *   Statistic * stat = createStatistic("wentropy");
+ *   stat->calculate(msa);
+ *   Span<float> scores = stat->getScores();
+ *   delete stat;
+ *
+ * The alignment and the statistics only read the context installed in
+ * the calling thread (the threads of a calculation share it), so
+ * several threads can run independent calculations with their own
+ * context. The results can also be written in any format by write()
+ * on a Writer in memory. Several views of one alignment (sequences
+ * and range of columns) can be made by Msa(parent, rows, first, last)
+ * without reading it again (filterIdentity() gives the rows of the
+ * representative sequences), bootstrapStats() gives intervals of the
+ * column statistics over resampled sequences, and the column statistics smoothed over
+ * several widths of side columns by smoothSweep().
+ */
+
+#include "context.h"
+#include "span.h"
+#include "msa.h"
+#include "statistic.h"
+#include "smooth.h"
+#include "bootstrap.h"
+#include "filter.h"
+#include "writer.h"
+
+#endif
@@ -20,12 +20,13 @@
  */
 
 #include "mvector.h"
-#include "options.h"
+#include "context.h"
 #include "scoring_matrix.h"
+#include "parallel.h"
+#include "kernels.h"
+#include "arena.h"
 
 #include <cmath>
-#include <fstream>
-#include <iomanip>
 
 using namespace std;
 
@@ -36,59 +37,75 @@ MVectStat :: calculate(Msa & msa)
 	int N = msa.getNseq();
 	
 	/* Get the scoring matrix */
-	ScoringMatrix score_mat(Options::Get().matrix_fname);
+	ScoringMatrix & score_mat = ScoringMatrix::Get(Context::Get().matrix_fname);
 	
-	/* Remove the unknown symbol from msa (consider them as gaps)*/
+	/* The symbols unknown by the scoring matrix are considered as gaps */
 	sm_alphabet = score_mat.getAlphabet();
-	msa.fitToAlphabet(sm_alphabet);
 	
 	/* Calculate the mean vector for each column */
 	int K = (int) sm_alphabet.size();
-	means = vector<vector<float> >(L);
+	means.assign((size_t) L * K, 0.0);
 	
-	for (int col(0); col < L; col++) {
-		vector<float> mean_col(K, 0.0);
-		for (int seq(0); seq < N; ++seq) {
-			if (msa.getSymbol(seq,col) == '-'){
-				continue;
-			} else {
-				for (int a(0); a < K; ++a) {
-					mean_col[a] += score_mat.normScore(sm_alphabet[a],msa.getSymbol(seq,col));
+	const string & alphabet = msa.getAlphabet();
+	vector<int> sm_pos(alphabet.size(), -1);
+	for (int b(0); b < (int) alphabet.size(); ++b) {
+		if (alphabet[b] != '-'){
+			sm_pos[b] = score_mat.getPos(alphabet[b]);
+		}
+	}
+	int stride = score_mat.getStride();
+	parallelFor(0, L, [&](int first, int last){
+		Scratch scratch;
+		float * mean_col = scratch.get<float>(stride);
+		for (int col(first); col < last; col++) {
+			const int * count = msa.getCount(col);
+			fill(mean_col, mean_col + stride, 0.0);
+			for (int b(0); b < (int) alphabet.size(); ++b) {
+				if (sm_pos[b] < 0 || count[b] == 0){
+					continue;
+				} else {
+					addScaledRow(mean_col, score_mat.normRow(sm_pos[b]), (float) count[b], stride);
 				}
 			}
+			for (int a(0); a < K; ++a) {
+				means[(size_t) col * K + a] = mean_col[a] / (float) N;
+			}
 		}
-		for (int a(0); a < K; ++a) {
-			mean_col[a] /= (float) N;
-		}
-		means[col] = mean_col;
-	}
+	});
 }
 
+/* Print the mean vector of each column, one column per line,
+ * the first line gives the symbols of the scoring matrix.
+ * In tsv the fields are right aligned on 10 characters with 3
+ * significant digits. */
 void
-MVectStat :: print(Msa & msa)
+MVectStat :: write(Msa & msa, Writer & out)
 {
-	/* Print the output */
-	ofstream file(Options::Get().output_fname.c_str());
-	if (!file.is_open()){
-	  cerr << "Cannot open file " << Options::Get().output_fname << "\n";
-		exit(0);
-	}
 	int K = (int) sm_alphabet.size();
-	file.precision(3);
-	file << setw(10) << " ";
+	int L = K ? (int) (means.size() / K) : 0;
+	if (out.isBinary()){
+		out.header("MSTX1D", L, K);
+		out.floats(means.data(), (size_t) L * K);
+		return;
+	}
+	bool csv = out.getSeparator() == ',';
+	int width = csv ? 0 : 10;
+	out.text(csv ? "" : " ", width);
 	for (int a(0); a < K; ++a) {
-		file.precision(3);
-		file << setw(10) << sm_alphabet[a];
+		if (csv){
+			out.sep();
+		}
+		out.chr(sm_alphabet[a], width);
 	}
-	file << "\n";
-	for (int col(0); col < (int) means.size(); col++) {
-		file.precision(3);
-		file << setw(10) << col + 1;
-  	for (int a(0); a < K; ++a) {
-			file.precision(3);	
-			file << setw(10) << means[col][a];
+	out.endl();
+	for (int col(0); col < L; col++) {
+		out.integer(msa.getFirstCol() + col + 1, width);
+		for (int a(0); a < K; ++a) {
+			if (csv){
+				out.sep();
+			}
+			out.real(means[(size_t) col * K + a], 3, width);
 		}
-		file << "\n";
+		out.endl();
 	}
-	file.close();
 }
@@ -28,10 +28,12 @@ class MVectStat  : public Statistic
 {
 private:
 	string sm_alphabet;
-	vector<vector<float> > means; /**< mean vector of each columns (Size = nb columns * nb symbols in alphabet)*/
+	vector<float> means; /**< mean vector of each columns, row by row (Size = nb columns * nb symbols in alphabet)*/
 public:
 	void calculate(Msa & msa);
-	void print(Msa & msa);
+	Span<float> getScores() const {return Span<float>(means.data(), means.size());};	/**< The mean vectors, one row of getAlphabet().size() values per column */
+	const string & getAlphabet() const {return sm_alphabet;};	/**< The symbols of the scoring matrix, in the order of the mean vectors */
+	void write(Msa & msa, Writer & out);
 };
 
 #endif
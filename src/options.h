@@ -31,6 +31,8 @@
 #include <iostream>
 #include <stdexcept>
 
+#include "context.h"
+
 using namespace std;
 
 /* This class is a virtual interface for the arguments */
@@ -189,8 +191,9 @@ class SwitchArg : public Arg
 /*
  * The Options class manages the argument given on the command line.
  * The implementation is static and then accessible from anywhere.
+ * Its settings are the Context used when no other one is installed.
  */
-class Options
+class Options : public Context
 {
 	private:
 		string appName;
@@ -215,11 +218,30 @@ class Options
 			env_p = getenv(env.c_str());
 			if (env_p != NULL)
 				env_s = env_p;
-			else
-				cerr << "Warning: Environment variable " << env << " is not found\n";
 			return env_s;
 		}
 
+		// Parse a comma separated list of numbers and ranges from 1 (e.g. "1-10,15") in ranges [first, last[ from 0
+		vector<pair<int, int> > parseRanges(const string & list, const string & flag)
+		{
+			vector<pair<int, int> > ranges;
+			istringstream items(list);
+			string item;
+			while (getline(items, item, ',')){
+				if (item.empty()){
+					continue;
+				}
+				size_t dash = item.find('-');
+				int first = atoi(item.substr(0, dash).c_str());
+				int last  = (dash == string::npos) ? first : atoi(item.substr(dash + 1).c_str());
+				if (first < 1 || last < first){
+					throw runtime_error("Bad range " + item + " (" + flag + ")\n");
+				}
+				ranges.push_back(make_pair(first - 1, last));
+			}
+			return ranges;
+		}
+
 		// Reduce a pathname in a basename
 		string basename(string fname)
 		{
@@ -238,11 +260,10 @@ class Options
 				// Set the application name
 				appName = basename(argv[0]);
 
-				// Get the environment variable to find the scoring matrix
-				string smat_path = getEnvVar("SCORE_MAT_PATH");
-				if (smat_path.empty()) {
-					smat_path = "data/aaindex";
-					cerr << "SCORE_MAT_PATH is not set, use data/aaindex instead\n";
+				// Get the environment variable to find the scoring matrices which are not embedded
+				matrix_path = getEnvVar("SCORE_MAT_PATH");
+				if (matrix_path.empty()) {
+					matrix_path = "data/aaindex";
 				}
 				/*
 				 * 2 sorts of arguments can be added:
@@ -254,11 +275,11 @@ class Options
 				 */
 
 				//1 - create the argument as a ValueArg or SwitchArg.
-				ValueArg<string> iArg("-i", "--input",     "MSA input file name"                                    );
-				ValueArg<string> mArg("-m", "--matrix",    "Score matrix file name",   smat_path+"/HENS920102.mat");
-				ValueArg<string> oArg("-o", "--output",    "Output file name [default=ouput.txt]",      "output.txt");
-				ValueArg<string> sArg("-s", "--statistic", "Statistics [default=wentropy]",               "wentropy");
-				ValueArg<int>    nArg("-n", "--nb_seq",    "Maximum number of sequences read [default=500]",     500);
+				ValueArg<string> iArg("-i", "--input",     "MSA input file name",                                    "");
+				ValueArg<string> mArg("-m", "--matrix",    "Score matrix file name or embedded matrix name [default=HENS920102]", "HENS920102");
+				ValueArg<string> oArg("-o", "--output",    "Output file name (directory in batch mode) [default=ouput.txt]", "output.txt");
+				ValueArg<string> sArg("-s", "--statistic", "Statistics, comma separated list [default=wentropy]", "wentropy");
+				ValueArg<int>    nArg("-n", "--nb_seq",    "Maximum number of sequences read, 0 for all [default=0]",  0);
 				SwitchArg        vArg("-v", "--verbose",   "Verbose mode",                                     false);
 				SwitchArg        gArg("-g", "--global",    "Output the global score",                          false);
 				SwitchArg        hArg("-h", "--help",      "Print this help",                                  false);
@@ -266,7 +287,25 @@ class Options
 				ValueArg<float>  aArg("-a", "--trident_a", "Factor applied to t(x) (see trident) [default=1.0]", 1.0);
 				ValueArg<float>  bArg("-b", "--trident_b", "Factor applied to r(x) (see trident) [default=0.5]", 0.5);
 				ValueArg<float>  cArg("-c", "--trident_c", "Factor applied to g(x) (see trident) [default=3.0]", 3.0);
-				ValueArg<int>    wArg("-w", "--window",    "Number of side columns (jensen score)",                3);
+				ValueArg<string> wArg("-w", "--window",    "Also output the column statistics smoothed over w side columns (comma separated list of w for a sweep)", "");
+				ValueArg<int>    pArg("-p", "--threads",   "Number of threads, 0 for all cores [default=1]",       1);
+				SwitchArg        SArg("-S", "--stream",    "Read the alignment by blocks of sequences (bounded memory)", false);
+				ValueArg<string> IArg("-I", "--incremental", "State file of the counts, only the sequences appended since the last run are counted (stream mode, edits of the counted sequences are checked on samples of the file)", "");
+				ValueArg<int>    BArg("-B", "--block",     "Number of sequences per block in stream mode [default=10000]", 10000);
+				SwitchArg        XArg("-X", "--matrix_cache", "Use a binary cache of the scoring matrix (matrix.mat.bin)", false);
+				SwitchArg        MArg("-M", "--msa_cache", "Use a binary cache of the alignment (input.msabin)", false);
+				ValueArg<string> lArg("-l", "--list",      "File listing the MSA files, or directory of MSA files (batch mode)", "");
+				SwitchArg        CArg("-C", "--combined",  "Write the results of all the MSA files in the output file (batch mode)", false);
+				ValueArg<string> FArg("-F", "--format",    "Output format: tsv, csv or bin [default=tsv]",       "tsv");
+				ValueArg<string> fArg("-f", "--pair_format", "Output of pairwise statistics: sparse, dense, top or bin [default=sparse]", "sparse");
+				SwitchArg        PArg("-P", "--profile",   "Print the time of each phase, the bytes read and written and the peak memory", false);
+				ValueArg<string> JArg("-J", "--profile_json", "Write the profile of -P in JSON in this file", "");
+				ValueArg<string> rArg("-r", "--rows",      "Sequences of the view, numbers and ranges from 1 (e.g. 1-50,72) [default=all]", "");
+				ValueArg<string> xArg("-x", "--columns",   "Columns of the view, a range from 1 (e.g. 120-310) [default=all]", "");
+				ValueArg<int>    RArg("-R", "--bootstrap", "Number of bootstrap replicates of the sequences, adds the mean and the 95% interval of the column statistics [default=0]", 0);
+				ValueArg<int>    eArg("-e", "--seed",      "Seed of the bootstrap draws [default=1]", 1);
+				ValueArg<float>  dArg("-d", "--max_id",    "Keep representative sequences, of identity at most max_id with each other (e.g. 0.9) [default=1.0, all]", 1.0);
+				ValueArg<int>    kArg("-k", "--top",       "Number of best pairs printed per column with -f top [default=10]", 10);
 
 				// 2 -  add the argument to the arg_list for further use (print_usage).
 				arg_list[iArg.getSmallFlag()] = iArg;
@@ -282,6 +321,24 @@ class Options
 				arg_list[bArg.getSmallFlag()] = bArg;
 				arg_list[cArg.getSmallFlag()] = cArg;
 				arg_list[wArg.getSmallFlag()] = wArg;
+				arg_list[pArg.getSmallFlag()] = pArg;
+				arg_list[SArg.getSmallFlag()] = SArg;
+				arg_list[IArg.getSmallFlag()] = IArg;
+				arg_list[BArg.getSmallFlag()] = BArg;
+				arg_list[XArg.getSmallFlag()] = XArg;
+				arg_list[MArg.getSmallFlag()] = MArg;
+				arg_list[lArg.getSmallFlag()] = lArg;
+				arg_list[CArg.getSmallFlag()] = CArg;
+				arg_list[FArg.getSmallFlag()] = FArg;
+				arg_list[fArg.getSmallFlag()] = fArg;
+				arg_list[kArg.getSmallFlag()] = kArg;
+				arg_list[PArg.getSmallFlag()] = PArg;
+				arg_list[JArg.getSmallFlag()] = JArg;
+				arg_list[rArg.getSmallFlag()] = rArg;
+				arg_list[xArg.getSmallFlag()] = xArg;
+				arg_list[RArg.getSmallFlag()] = RArg;
+				arg_list[eArg.getSmallFlag()] = eArg;
+				arg_list[dArg.getSmallFlag()] = dArg;
 
 				// 3 - try to find the argument in the command line to set up the value.
 				hArg.find(command_line);
@@ -297,6 +354,24 @@ class Options
 				bArg.find(command_line);
 				cArg.find(command_line);
 				wArg.find(command_line);
+				pArg.find(command_line);
+				SArg.find(command_line);
+				IArg.find(command_line);
+				BArg.find(command_line);
+				XArg.find(command_line);
+				MArg.find(command_line);
+				lArg.find(command_line);
+				CArg.find(command_line);
+				FArg.find(command_line);
+				fArg.find(command_line);
+				kArg.find(command_line);
+				PArg.find(command_line);
+				JArg.find(command_line);
+				rArg.find(command_line);
+				xArg.find(command_line);
+				RArg.find(command_line);
+				eArg.find(command_line);
+				dArg.find(command_line);
 
 				// If something is left in the command line... It is not an argument of the program -> error
 				if (command_line.size() > 0){
@@ -315,27 +390,91 @@ class Options
 				factor_a     = aArg.getValue();
 				factor_b     = bArg.getValue();
 				factor_c     = cArg.getValue();
-				window       = wArg.getValue();
+				windows.clear();
+				istringstream widths(wArg.getValue());
+				string width;
+				while (getline(widths, width, ',')){
+					if (width.empty()){
+						continue;
+					}
+					windows.push_back(atoi(width.c_str()));
+					if (windows.back() <= 0){
+						throw runtime_error("The number of side columns must be positive (-w " + width + ")\n");
+					}
+				}
+				threads      = pArg.getValue();
+				state_fname  = IArg.getValue();
+				stream       = SArg.getValue() || !state_fname.empty();
+				block_size   = BArg.getValue();
+				matrix_cache = XArg.getValue();
+				msa_cache    = MArg.getValue();
+				batch        = lArg.getValue();
+				combined     = CArg.getValue();
+				out_format   = FArg.getValue();
+				if (input_fname.empty() && batch.empty()){
+					throw runtime_error("Argument " + iArg.getSmallFlag() + ", " + iArg.getLongFlag() + " is needed\n");
+				}
+				if (!state_fname.empty() && !batch.empty()){
+					throw runtime_error("The incremental mode (-I) needs one input file (-i), not a batch (-l)\n");
+				}
+				if (combined && out_format == "bin"){
+					throw runtime_error("Binary output cannot be combined (-C with -F bin)\n");
+				}
+				pair_format  = fArg.getValue();
+				if (out_format != "tsv" && out_format != "csv" && out_format != "bin"){
+					throw runtime_error("Unknown output format: " + out_format + "\n");
+				}
+				top_k        = kArg.getValue();
+				if (top_k < 1){
+					throw runtime_error("The number of best pairs must be at least 1 (-k)\n");
+				}
+				profile      = PArg.getValue();
+				profile_json = JArg.getValue();
+				rows.clear();
+				vector<pair<int, int> > row_ranges = parseRanges(rArg.getValue(), "-r");
+				for (int r(0); r < (int) row_ranges.size(); ++r){
+					for (int seq(row_ranges[r].first); seq < row_ranges[r].second; ++seq){
+						rows.push_back(seq);
+					}
+				}
+				vector<pair<int, int> > col_ranges = parseRanges(xArg.getValue(), "-x");
+				if (col_ranges.size() > 1){
+					throw runtime_error("Only one range of columns can be given (-x)\n");
+				}
+				first_col = col_ranges.empty() ? 0 : col_ranges[0].first;
+				last_col  = col_ranges.empty() ? 0 : col_ranges[0].second;
+				bootstrap    = RArg.getValue();
+				seed         = eArg.getValue();
+				max_id       = dArg.getValue();
+				if (max_id < 0 || max_id > 1){
+					throw runtime_error("The maximum identity must be between 0 and 1 (-d)\n");
+				}
+				if (bootstrap < 0){
+					throw runtime_error("The number of bootstrap replicates cannot be negative (-R)\n");
+				}
+				if ((!rows.empty() || !col_ranges.empty() || bootstrap > 0 || max_id < 1) && stream){
+					throw runtime_error("A view (-r, -x), the identity filter (-d) or the bootstrap (-R) needs the whole alignment, not the stream mode (-S, -I)\n");
+				}
+				if (pair_format != "sparse" && pair_format != "dense" && pair_format != "top" && pair_format != "bin"){
+					throw runtime_error("Unknown pair format: " + pair_format + "\n");
+				}
+				pair_sinks   = !global && out_format != "bin" && (pair_format == "sparse" || pair_format == "top");
+
+				// Split the list of statistics
+				statistics.clear();
+				istringstream list(statistic);
+				string name;
+				while (getline(list, name, ',')){
+					if (!name.empty()){
+						statistics.push_back(name);
+					}
+				}
 			} catch (exception &e) {
 				throw;
 			}
 		}
 
 	public:
-		/* List of options */
-	string input_fname;  // The file name of the multiple alignment */
-	string matrix_fname; // The file name of the scoring matrix */
-		string output_fname; // The name of the output file */
-		string statistic;    // The name of the statistic */
-		int    nb_seq;       // The number of sequences to read in the multiple alignment */
-		bool   verbose;      // The switch for verbose mode */
-		bool   global;       // The switch to output only the global alignment score */
-		float  threshold;    // The threshold for correlation print */
-		float  factor_a;     // The factor applied to the first  member of trident score */
-		float  factor_b;     // The factor applied to the second member of trident score */
-		float  factor_c;     // The factor applied to the third  member of trident score */
-		int    window;       // The size of the window to take in account side columns (jensen stat only) */
-
 		/* Universal accessor */
 		static Options const & Get()
 		{
@@ -392,6 +531,10 @@ class Options
 			cerr << "  jensen   (1)\n";
 			cerr << "  kabat    (1)\n";
 			cerr << "  gap      (1)\n";
+			cerr << "  mi       (2)\n";
+			cerr << "  mi_apc   (2)\n";
+			cerr << "  sca      (2)\n";
+			cerr << "(1) statistic of each column, (2) statistic of each pair of columns\n";
 			cerr << "\nOptions:\n";
 			it = opt.arg_list.begin();
 			while (it != opt.arg_list.end()){
@@ -0,0 +1,94 @@
+/* Copyright (c) 2012 Guillaume Collet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __PARALLEL_H__
+#define __PARALLEL_H__
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "context.h"
+
+using namespace std;
+
+/* Number of threads given by the option -p (all the cores if 0) */
+int nbThreads();
+
+/* True in a thread started by parallelFor, nested loops are run serially */
+bool inParallel();
+void setInParallel(bool value);
+
+/*
+ * parallelFor(begin, end, f) calls f(first, last) on consecutive chunks
+ * [first, last[ covering [begin, end[.
+ * Chunks are small compared to the range and are taken on demand by
+ * the threads, so columns of different costs are balanced.
+ * Each index is processed by exactly one call of f, so as long as the
+ * iterations are independent, the result does not depend on the number
+ * of threads.
+ * The threads run with the context of the calling thread.
+ * A chunk size can be given for iterations of large cost (e.g. one
+ * alignment file per iteration).
+ */
+template <class Function>
+void parallelFor(int begin, int end, Function f, int chunk = 0)
+{
+	int size = end - begin;
+	int nthread = inParallel() ? 1 : nbThreads();
+	if (nthread > size){
+		nthread = size;
+	}
+	if (nthread <= 1){
+		if (size > 0){
+			f(begin, end);
+		}
+		return;
+	}
+	
+	/* 8 chunks per thread let the fastest threads take more columns */
+	if (chunk <= 0){
+		chunk = size / (8 * nthread);
+	}
+	if (chunk < 1){
+		chunk = 1;
+	}
+	atomic<int> next(begin);
+	const Context & ctx = Context::Get();
+	vector<thread> workers;
+	for (int t(0); t < nthread; ++t){
+		workers.push_back(thread([&](){
+			ContextScope scope(ctx);
+			setInParallel(true);
+			int first;
+			while ((first = next.fetch_add(chunk)) < end){
+				int last = (first + chunk < end) ? first + chunk : end;
+				f(first, last);
+			}
+			setInParallel(false);
+		}));
+	}
+	for (int t(0); t < nthread; ++t){
+		workers[t].join();
+	}
+}
+
+#endif
@@ -0,0 +1,136 @@
+/* Copyright (c) 2012 Guillaume Collet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <algorithm>
+#include <mutex>
+#include <iomanip>
+#include <sys/resource.h>
+
+#include "profile.h"
+
+using namespace std;
+
+bool Profile::on = false;
+
+static vector<PhaseTime> phase_list;
+static vector<ByteCount> counter_list;
+static mutex phase_lock;
+
+void
+Profile :: add(const string & name, double wall, double cpu, double thread_cpu)
+{
+	lock_guard<mutex> guard(phase_lock);
+	for (size_t i(0); i < phase_list.size(); ++i){
+		if (phase_list[i].name == name){
+			phase_list[i].calls++;
+			phase_list[i].wall += wall;
+			phase_list[i].cpu += cpu;
+			phase_list[i].thread_cpu += thread_cpu;
+			return;
+		}
+	}
+	PhaseTime phase = {name, 1, wall, cpu, thread_cpu};
+	phase_list.push_back(phase);
+}
+
+void
+Profile :: countBytes(const char * name, uint64_t bytes)
+{
+	lock_guard<mutex> guard(phase_lock);
+	for (size_t i(0); i < counter_list.size(); ++i){
+		if (counter_list[i].name == name){
+			counter_list[i].bytes += bytes;
+			return;
+		}
+	}
+	ByteCount counter = {name, bytes};
+	counter_list.push_back(counter);
+}
+
+void
+Profile :: reset()
+{
+	lock_guard<mutex> guard(phase_lock);
+	phase_list.clear();
+	counter_list.clear();
+}
+
+vector<PhaseTime>
+Profile :: phases()
+{
+	lock_guard<mutex> guard(phase_lock);
+	return phase_list;
+}
+
+vector<ByteCount>
+Profile :: counters()
+{
+	lock_guard<mutex> guard(phase_lock);
+	return counter_list;
+}
+
+long
+Profile :: peakMemory()
+{
+	struct rusage usage;
+	return getrusage(RUSAGE_SELF, &usage) == 0 ? usage.ru_maxrss : 0;
+}
+
+void
+Profile :: print(ostream & out)
+{
+	vector<PhaseTime> list = phases();
+	vector<ByteCount> bytes = counters();
+	size_t width = 5;
+	for (size_t i(0); i < list.size(); ++i){
+		width = max(width, list[i].name.size());
+	}
+	out << "\nProfile:\n" << left << setw(width) << "phase" << right
+	    << setw(8) << "calls" << setw(12) << "wall (s)" << setw(12) << "cpu (s)" << setw(12) << "thread (s)" << "\n";
+	out << fixed << setprecision(4);
+	for (size_t i(0); i < list.size(); ++i){
+		out << left << setw(width) << list[i].name << right << setw(8) << list[i].calls
+		    << setw(12) << list[i].wall << setw(12) << list[i].cpu << setw(12) << list[i].thread_cpu << "\n";
+	}
+	out.unsetf(ios::floatfield);
+	out << setprecision(6);
+	for (size_t i(0); i < bytes.size(); ++i){
+		out << bytes[i].name << " bytes: " << bytes[i].bytes << "\n";
+	}
+	out << "peak memory: " << peakMemory() << " KB\n";
+}
+
+void
+Profile :: printJson(ostream & out)
+{
+	vector<PhaseTime> list = phases();
+	vector<ByteCount> bytes = counters();
+	out << "{\"phases\": [";
+	for (size_t i(0); i < list.size(); ++i){
+		out << (i ? ",\n  " : "\n  ") << "{\"name\": \"" << list[i].name << "\", \"calls\": " << list[i].calls
+		    << ", \"wall\": " << list[i].wall << ", \"cpu\": " << list[i].cpu << ", \"thread_cpu\": " << list[i].thread_cpu << "}";
+	}
+	out << "\n ],\n \"bytes\": {";
+	for (size_t i(0); i < bytes.size(); ++i){
+		out << (i ? ", " : "") << "\"" << bytes[i].name << "\": " << bytes[i].bytes;
+	}
+	out << "},\n \"peak_memory_kb\": " << peakMemory() << "}\n";
+}
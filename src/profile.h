@@ -0,0 +1,114 @@
+/* Copyright (c) 2012 Guillaume Collet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __PROFILE_H__
+#define __PROFILE_H__
+
+#include <string>
+#include <vector>
+#include <ostream>
+#include <ctime>
+#include <chrono>
+#include <stdint.h>
+
+using namespace std;
+
+/* Time spent in a phase of the run */
+struct PhaseTime
+{
+	string name;
+	int    calls;      /**< Number of times the phase was run */
+	double wall;       /**< Wall-clock seconds */
+	double cpu;        /**< CPU seconds of all the threads of the process */
+	double thread_cpu; /**< CPU seconds of the threads which ran the phase (the workers of parallelFor excluded) */
+};
+
+/* Number of bytes of a kind of data (input, output) */
+struct ByteCount
+{
+	string   name;
+	uint64_t bytes;
+};
+
+/*
+ * Profile accumulates the time of the named phases of a run (measured
+ * by ScopedTimer) and the number of bytes read and written. It is off
+ * by default, a timer or a counter then costs one test.
+ * The phases may be nested and run by several threads at once, then
+ * the CPU time of the process counts the work of all the phases
+ * running at the same time.
+ */
+class Profile
+{
+public:
+	static bool enabled() {return on;};
+	static void enable(bool value) {on = value;};
+	static void add(const string & name, double wall, double cpu, double thread_cpu);
+	static void addBytes(const char * name, uint64_t bytes) {if (on) countBytes(name, bytes);};	/**< Count bytes of data name */
+	static void reset();
+	static vector<PhaseTime> phases();	/**< Phases in the order they first ended (nested phases before their parent) */
+	static vector<ByteCount> counters();	/**< Byte counters in order of first count */
+	static long peakMemory();						/**< Peak resident memory of the process in KB */
+	static void print(ostream & out);		/**< Print the phases, counters and peak memory as a table */
+	static void printJson(ostream & out);	/**< Same as print in JSON */
+
+private:
+	static bool on;
+	static void countBytes(const char * name, uint64_t bytes);
+};
+
+/* Seconds of the clock id (CLOCK_PROCESS_CPUTIME_ID, CLOCK_THREAD_CPUTIME_ID) */
+inline double
+cpuSeconds(clockid_t id)
+{
+	struct timespec ts;
+	clock_gettime(id, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* A ScopedTimer adds the time from its construction to its destruction
+ * to the phase given, if the profile is enabled */
+class ScopedTimer
+{
+private:
+	bool   on;
+	string name;
+	chrono::steady_clock::time_point wall0;
+	double cpu0, thread0;
+
+	void start(){
+		wall0 = chrono::steady_clock::now();
+		cpu0 = cpuSeconds(CLOCK_PROCESS_CPUTIME_ID);
+		thread0 = cpuSeconds(CLOCK_THREAD_CPUTIME_ID);
+	}
+
+public:
+	ScopedTimer(const char * phase) : on(Profile::enabled()) {if (on){name = phase; start();}};
+	ScopedTimer(const string & phase) : on(Profile::enabled()) {if (on){name = phase; start();}};
+	~ScopedTimer(){
+		if (on){
+			double wall = chrono::duration<double>(chrono::steady_clock::now() - wall0).count();
+			Profile::add(name, wall, cpuSeconds(CLOCK_PROCESS_CPUTIME_ID) - cpu0, cpuSeconds(CLOCK_THREAD_CPUTIME_ID) - thread0);
+		}
+	};
+};
+
+#endif
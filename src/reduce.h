@@ -0,0 +1,85 @@
+/* Copyright (c) 2012 Guillaume Collet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __REDUCE_H__
+#define __REDUCE_H__
+
+#include <vector>
+#include <cstddef>
+#include <cmath>
+
+#include "parallel.h"
+
+using namespace std;
+
+/* Number of values summed by one task of reduceSum */
+#define REDUCE_CHUNK 4096
+
+/*
+ * KahanSum is a compensated sum (Neumaier's variant of Kahan): the
+ * low bits lost by each addition are kept apart and added at the end.
+ */
+struct KahanSum
+{
+	double sum;
+	double low;		/**< Sum of the rounding errors of the additions */
+	
+	KahanSum() : sum(0.0), low(0.0) {};
+	void add(double x){
+		double t = sum + x;
+		low += (fabs(sum) >= fabs(x)) ? (sum - t) + x : (x - t) + sum;
+		sum = t;
+	};
+	double get() const {return sum + low;};
+};
+
+/* Sum of the n values by a pairwise tree in a fixed order */
+double pairwiseSum(const double * values, int n);
+
+/*
+ * reduceSum(n, value) returns the sum of value(i) for i in [0, n[.
+ * The values are summed by chunks of REDUCE_CHUNK (a compensated sum
+ * per chunk, run by the threads), then the sums of the chunks by a
+ * pairwise tree. The chunks and the tree only depend on n, so the
+ * result is the same bit for bit whatever the number of threads.
+ */
+template <class Function>
+double reduceSum(size_t n, Function value)
+{
+	int nchunk = (int) ((n + REDUCE_CHUNK - 1) / REDUCE_CHUNK);
+	vector<double> partial(nchunk);
+	parallelFor(0, nchunk, [&](int first, int last){
+		for (int c(first); c < last; ++c){
+			KahanSum s;
+			size_t end = ((size_t) c + 1) * REDUCE_CHUNK < n ? ((size_t) c + 1) * REDUCE_CHUNK : n;
+			for (size_t i((size_t) c * REDUCE_CHUNK); i < end; ++i){
+				s.add(value(i));
+			}
+			partial[c] = s.get();
+		}
+	});
+	return pairwiseSum(partial.data(), nchunk);
+}
+
+/* Sum of the n floats of values (see reduceSum) */
+double sumFloats(const float * values, size_t n);
+
+#endif
@@ -0,0 +1,83 @@
+/* Copyright (c) 2012 Guillaume Collet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "sca.h"
+#include "background.h"
+
+#include <cmath>
+
+/** calculate(msa)
+ *
+ * Calculate the correlation between columns as in the statistical
+ * coupling analysis (Halabi et al. 2009) :
+ * \tilde{C}_{xy} = \sqrt{\sum_{a,b} (\phi_x^a \phi_y^b (f_{xy}^{ab} - f_x^a f_y^b))^2}
+ * With \phi_x^a = log(\frac{f_x^a (1 - q^a)}{(1 - f_x^a) q^a})
+ * f are the weighted frequencies and q the background frequencies,
+ * only the amino acids are taken in account (gaps are excluded).
+ */
+void
+SCAStat :: calculate(Msa & msa)
+{
+	const string & alphabet = msa.getAlphabet();
+	int L = msa.getNcol();
+	sca_sym.clear();
+	for (int a(0); a < (int) alphabet.size(); ++a){
+		if (backgroundFreq(alphabet[a]) > 0.0){
+			sca_sym.push_back(a);
+		}
+	}
+	int S = (int) sca_sym.size();
+	phi.assign((size_t) L * S, 0.0);
+	freq.assign((size_t) L * S, 0.0);
+	for (int x(0); x < L; ++x){
+		const float * p = msa.getWeightedCount(x);
+		for (int s(0); s < S; ++s){
+			float q = backgroundFreq(alphabet[sca_sym[s]]);
+			float f = p[sca_sym[s]];
+			float f_clamp = f < 1e-6 ? 1e-6 : (f > 1 - 1e-6 ? 1 - 1e-6 : f);
+			freq[(size_t) x * S + s] = f;
+			phi[(size_t) x * S + s] = log(f_clamp * (1 - q) / ((1 - f_clamp) * q));
+		}
+	}
+	calcPairs(msa);
+}
+
+float
+SCAStat :: pairScore(Msa & msa, int x, int y, const float * joint, int stride)
+{
+	int S = (int) sca_sym.size();
+	const float * phi_x = &phi[(size_t) x * S];
+	const float * phi_y = &phi[(size_t) y * S];
+	const float * f_x = &freq[(size_t) x * S];
+	const float * f_y = &freq[(size_t) y * S];
+	float score = 0.0;
+	for (int a(0); a < S; ++a){
+		if (f_x[a] == 0.0){
+			continue;
+		}
+		const float * f_ab = joint + sca_sym[a] * stride;
+		for (int b(0); b < S; ++b){
+			float c = phi_x[a] * phi_y[b] * (f_ab[sca_sym[b]] - f_x[a] * f_y[b]);
+			score += c * c;
+		}
+	}
+	return sqrt(score);
+}
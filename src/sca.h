@@ -0,0 +1,40 @@
+/* Copyright (c) 2012 Guillaume Collet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __SCA_H__
+#define __SCA_H__
+
+#include "statistic.h"
+
+/* Statistical coupling analysis correlation of pairs of columns */
+class SCAStat : public Stat2D
+{
+private:
+	vector<int>   sca_sym;  /**< Positions in the alphabet of the symbols having a background frequency */
+	vector<float> phi;      /**< Weight phi of each of these symbols in each column (size = ncol * sca_sym.size()) */
+	vector<float> freq;     /**< Weighted frequency of each of these symbols in each column */
+protected:
+	float pairScore(Msa & msa, int x, int y, const float * joint, int stride);
+public:
+	void calculate(Msa & msa);
+};
+
+#endif
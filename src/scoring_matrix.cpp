@@ -21,140 +21,310 @@
 #include <iostream>
 #include <fstream>
 #include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <sys/stat.h>
 
-#include "options.h"
+#include "context.h"
 #include "scoring_matrix.h"
+#include "kernels.h"
+#include "embedded_matrices.h"
+#include "profile.h"
 
 using namespace std;
 
 /** Constructor from a filename fname.
  *  Matrices are all in format defined by AAindex web site :
  *  http://www.genome.jp/aaindex/
+ *  With -X, the matrix is read in the binary cache fname.bin if it is
+ *  up to date, the cache is written after reading the text otherwise.
  */
-ScoringMatrix :: ScoringMatrix(string fname)
+ScoringMatrix :: ScoringMatrix(string fname) : matrix(NULL), is_set(false), norm_matrix(NULL)
 {
-  /* Open file */
+	ScopedTimer timer("readMatrix");
 	if(fname.empty()){
 		cerr << "Error, score matrix file name is empty\n";
 		exit(0);
 	}
-	if (Options::Get().verbose){
-		cout << "Read Scoring Matrix in " << fname << "\n";
+	/* A name which is not a file is an embedded matrix, or a file of SCORE_MAT_PATH */
+	struct stat info;
+	const EmbeddedMatrix * embedded = NULL;
+	if (stat(fname.c_str(), &info) != 0){
+		embedded = findEmbeddedMatrix(fname.c_str());
+		string path = Context::Get().matrix_path + "/" + fname + ".mat";
+		if (embedded == NULL && stat(path.c_str(), &info) == 0){
+			fname = path;
+		}
+	}
+	bool cached = embedded == NULL && Context::Get().matrix_cache && readCache(fname);
+	if (Context::Get().verbose){
+		cout << "Read Scoring Matrix " << (embedded ? "embedded " : "in ") << (cached ? cacheName(fname) : fname) << " (" << kernelName() << " kernels)\n";
+	}
+	if (embedded){
+		setAlphabet(embedded->alphabet);
+		size_t nval = (size_t) embedded->size * stride;
+		memcpy(matrix, embedded->raw, nval * sizeof(float));
+		memcpy(norm_matrix, embedded->norm, nval * sizeof(float));
+		min = embedded->min;
+		max = embedded->max;
+	} else if (!cached){
+		readText(fname);
+		if (Context::Get().matrix_cache){
+			writeCache(fname);
+		}
+	}
+	int alphabet_size = (int) alphabet.size();
+	
+	if (Context::Get().verbose){
+		cout << "Normalized :\n";
+		for (int i(0); i < alphabet_size; ++i) {
+			cout.width(9);
+			cout << alphabet[i];
+			for (int j(0); j <= i; j++){
+				cout.width(9);
+				cout << norm_matrix[i * stride + j];
+			}
+			cout << "\n";
+		}
+		cout << "\n";
+		cout.width(9);
+		cout << ' ';
+		for (int j(0); j <= alphabet_size ; j++){
+			cout.width(9);
+			cout << alphabet[j];
+		} 
+		cout << "\n\n";
+	}
+	
+	is_set = true;
+}
+
+/* Set the alphabet, its lookup table and allocate the matrices
+ * (aligned rows padded with zeros) */
+void
+ScoringMatrix :: setAlphabet(const string & alph)
+{
+	alphabet = alph;
+	int alphabet_size = (int) alphabet.size();
+	for (int c(0); c < 256; ++c){
+		sym_pos[c] = -1;
 	}
+	for (int i(0); i < alphabet_size; ++i){
+		sym_pos[(unsigned char) alphabet[i]] = i;
+	}
+	stride = (alphabet_size + 7) / 8 * 8;
+	size_t bytes = (size_t) alphabet_size * stride * sizeof(float);
+	if (posix_memalign((void **) &matrix, 32, bytes ? bytes : 32) != 0
+	 || posix_memalign((void **) &norm_matrix, 32, bytes ? bytes : 32) != 0){
+	  cerr << "Cannot allocate scoring matrix\n";
+		exit(0);
+	}
+	memset(matrix, 0, bytes);
+	memset(norm_matrix, 0, bytes);
+}
+
+/* Read the matrix in the AAindex text file fname */
+void
+ScoringMatrix :: readText(const string & fname)
+{
 	ifstream file(fname.c_str());
 	if (!file.good()){
 	  cerr << "Cannot open file " << fname << "\n";
 		exit(0);
 	}
 	
-	/* Read file */
+	/* Read file until the line of the alphabet (M rows = ...) */
 	string s;
 	getline(file,s);
-	while (file.good() && s[0] != 'M'){
+	while (file.good() && s.compare(0, 6, "M rows") != 0){
 	  getline(file,s);
 	}
 	
 	/* Read Alphabet */
 	int alphabet_begin = (int) s.find('=') + 2;
 	int alphabet_size = (int) s.find(',') - alphabet_begin;
-	alphabet = s.substr(alphabet_begin,	alphabet_size);
+	setAlphabet(s.substr(alphabet_begin,	alphabet_size));
 	
-	/* Allocate the matrix */
-	matrix = (float **) calloc (alphabet_size, sizeof(float *));
-	if (matrix == NULL){
-	  cerr << "Cannot allocate scoring matrix\n";
-		exit(0);
-	}
-	for (int i(0); i < alphabet_size; ++i) {
-		matrix[i] = (float *) calloc(i + 1, sizeof(float));
-		if (matrix[i] == NULL){
-			cerr << "Cannot allocate scoring matrix[" << i << "]\n";
-			exit(0);
-		}
-	}
-	
-	
-	/* Read the matrix */
+	/* Read the matrix (lower triangle) and fill both triangles */
   min = 1000; max = -1000;
 	for (int i(0); i < alphabet_size; ++i) {
 		getline(file,s);
 		for (int j(0); j <=i ; j++){
-			matrix[i][j] = atof(s.substr(j*8, 8).c_str());
-      if (matrix[i][j] < min)
-        min = matrix[i][j];
-      if (matrix[i][j] > max)
-        max = matrix[i][j];
-		}
-	}
-	
-	
-	/* Allocate the norm_matrix */
-	norm_matrix = (float **) calloc (alphabet_size, sizeof(float *));
-	if (norm_matrix == NULL){
-	  cerr << "Cannot allocate the normalized amino acid vector\n";
-		exit(0);
-	}
-	for (int i(0); i < alphabet_size; ++i) {
-		norm_matrix[i] = (float *) calloc(i+1, sizeof(float));
-		if (norm_matrix[i] == NULL){
-			cerr << "Cannot allocate norm_matrix[" << i << "]\n";
-			exit(0);
+			float val = atof(s.substr(j*8, 8).c_str());
+			matrix[i * stride + j] = val;
+			matrix[j * stride + i] = val;
+      if (val < min)
+        min = val;
+      if (val > max)
+        max = val;
 		}
 	}
 	
 	/* Calculate normalized vector */
-	
 	for (int i(0); i < alphabet_size; ++i) {
-		for (int j(0); j <= i; ++j){
-			norm_matrix[i][j] = (score(alphabet[i], alphabet[j]) - min) / (max - min);
+		for (int j(0); j < alphabet_size; ++j){
+			norm_matrix[i * stride + j] = (matrix[i * stride + j] - min) / (max - min);
 		}
 	}
-	
-	if (Options::Get().verbose){
-		cout << "Normalized :\n";
-		for (int i(0); i < alphabet_size; ++i) {
-			cout.width(9);
-			cout << alphabet[i];
-			for (int j(0); j <= i; j++){
-				cout.width(9);
-				cout << norm_matrix[i][j];
+}
+
+/*
+ * Binary cache of a matrix (native byte order, checked by the order field) :
+ * the header, the alphabet, then the raw and normalized matrices
+ * (size rows of stride floats each). The cache is valid while
+ * the size and modification time (to the nanosecond) of the text
+ * file are unchanged, and if the cache is newer than the text file.
+ */
+struct MatrixCacheHeader {
+	char     magic[8];   /**< "MSTXMAT" */
+	uint32_t version;    /**< 2 */
+	uint32_t order;      /**< 0x01020304 written in native order */
+	uint64_t src_size;   /**< Size of the text file */
+	int64_t  src_mtime;  /**< Modification time of the text file (seconds) */
+	int64_t  src_mtime_ns; /**< Nanoseconds of the modification time */
+	uint32_t size;       /**< Size of the alphabet */
+	uint32_t stride;     /**< Size of the rows */
+	float    min;
+	float    max;
+};
+
+string
+ScoringMatrix :: cacheName(const string & fname)
+{
+	return fname + ".bin";
+}
+
+/* Fill the fields of the header which identify the text file fname */
+static bool
+sourceHeader(const string & fname, MatrixCacheHeader & header)
+{
+	struct stat info;
+	if (stat(fname.c_str(), &info) != 0){
+		return false;
+	}
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, "MSTXMAT", 8);
+	header.version = 2;
+	header.order = 0x01020304;
+	header.src_size = (uint64_t) info.st_size;
+	header.src_mtime = (int64_t) info.st_mtim.tv_sec;
+	header.src_mtime_ns = (int64_t) info.st_mtim.tv_nsec;
+	return true;
+}
+
+bool
+ScoringMatrix :: readCache(const string & fname)
+{
+	MatrixCacheHeader expected, header;
+	if (!sourceHeader(fname, expected)){
+		return false;
+	}
+	FILE * file = fopen(cacheName(fname).c_str(), "rb");
+	if (file == NULL){
+		return false;
+	}
+	/* A cache written before the last change of the text file is stale */
+	struct stat info;
+	bool ok = fstat(fileno(file), &info) == 0
+	       && (info.st_mtim.tv_sec > expected.src_mtime
+	        || (info.st_mtim.tv_sec == expected.src_mtime && info.st_mtim.tv_nsec > expected.src_mtime_ns));
+	ok = ok && fread(&header, sizeof(header), 1, file) == 1
+	       && memcmp(header.magic, expected.magic, 8) == 0
+	       && header.version == expected.version
+	       && header.order == expected.order
+	       && header.src_size == expected.src_size
+	       && header.src_mtime == expected.src_mtime
+	       && header.src_mtime_ns == expected.src_mtime_ns
+	       && header.size < 256
+	       && header.stride == (header.size + 7) / 8 * 8;
+	if (ok){
+		string alph(header.size, ' ');
+		ok = fread(&alph[0], 1, header.size, file) == header.size;
+		if (ok){
+			setAlphabet(alph);
+			size_t nval = (size_t) header.size * stride;
+			ok = fread(matrix, sizeof(float), nval, file) == nval
+			  && fread(norm_matrix, sizeof(float), nval, file) == nval;
+			min = header.min;
+			max = header.max;
+			if (!ok){
+				free(matrix);
+				free(norm_matrix);
+				matrix = norm_matrix = NULL;
 			}
-			cout << "\n";
 		}
-		cout << "\n";
-		cout.width(9);
-		cout << ' ';
-		for (int j(0); j <= alphabet_size ; j++){
-			cout.width(9);
-			cout << alphabet[j];
-		} 
-		cout << "\n\n";
 	}
-	
-	is_set = true;
+	fclose(file);
+	return ok;
 }
 
-/* Destructor */
-ScoringMatrix :: ~ScoringMatrix()
+/* The cache is not written if the directory is read only */
+void
+ScoringMatrix :: writeCache(const string & fname)
 {
-	if (is_set){
-		for (int i(0); i < (int) alphabet.size(); ++i){
-			free(matrix[i]);
-		}
-		free(matrix);
-		for (int i(0); i < (int) alphabet.size(); ++i){
-			free(norm_matrix[i]);
+	MatrixCacheHeader header;
+	if (!sourceHeader(fname, header)){
+		return;
+	}
+	header.size = (uint32_t) alphabet.size();
+	header.stride = (uint32_t) stride;
+	header.min = min;
+	header.max = max;
+	string tmp_name = cacheName(fname) + ".tmp";
+	FILE * file = fopen(tmp_name.c_str(), "wb");
+	if (file == NULL){
+		if (Context::Get().verbose){
+			cerr << "Cannot write the matrix cache " << cacheName(fname) << "\n";
 		}
-		free(norm_matrix);
+		return;
+	}
+	size_t nval = alphabet.size() * stride;
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+	       && fwrite(alphabet.data(), 1, alphabet.size(), file) == alphabet.size()
+	       && fwrite(matrix, sizeof(float), nval, file) == nval
+	       && fwrite(norm_matrix, sizeof(float), nval, file) == nval;
+	ok = (fclose(file) == 0) && ok;
+	/* rename is atomic, so concurrent runs never read a partial cache */
+	if (!ok || rename(tmp_name.c_str(), cacheName(fname).c_str()) != 0){
+		remove(tmp_name.c_str());
+	}
+}
+
+/* Matrices read in this process, by directory and file name (the
+ * contexts of a program embedding the library may use several directories) */
+static map<string, unique_ptr<ScoringMatrix> > registry;
+static mutex registry_lock;
+
+/* The matrix of file fname is read at the first call only,
+ * then it is shared (read only) by all the statistics and threads */
+ScoringMatrix &
+ScoringMatrix :: Get(const string & fname)
+{
+	lock_guard<mutex> guard(registry_lock);
+	unique_ptr<ScoringMatrix> & mat = registry[Context::Get().matrix_path + "\n" + fname];
+	if (!mat){
+		mat.reset(new ScoringMatrix(fname));
 	}
+	return *mat;
+}
+
+/* Destructor */
+ScoringMatrix :: ~ScoringMatrix()
+{
+	free(matrix);
+	free(norm_matrix);
 	
 }
 
 int 
 ScoringMatrix :: index(char aa)
 {
-	int pos = (int) alphabet.find(aa);
-	if (pos >= (int) alphabet.size()){
+	int pos = sym_pos[(unsigned char) aa];
+	if (pos < 0){
 		cerr << "Symbol " << aa << " is not in alphabet\n";
 		exit(0);
 	} 
@@ -165,27 +335,11 @@ ScoringMatrix :: index(char aa)
 float
 ScoringMatrix :: score(char aa1, char aa2)
 {
-	int x,y;
-  int pos1 = index(aa1);
-	int pos2 = index(aa2);
-	if (pos1 > pos2){
-		x = pos1; y = pos2;
-	} else {
-	  x = pos2; y = pos1;	
-	}
-	return matrix[x][y];
+	return matrix[index(aa1) * stride + index(aa2)];
 }
 
 float 
 ScoringMatrix :: normScore(char aa1, char aa2)
 {
-	int x,y;
-  int pos1 = index(aa1);
-	int pos2 = index(aa2);
-	if (pos1 > pos2){
-		x = pos1; y = pos2;
-	} else {
-	  x = pos2; y = pos1;	
-	}
-	return norm_matrix[x][y];
+	return norm_matrix[index(aa1) * stride + index(aa2)];
 }
@@ -26,26 +26,46 @@
 
 using namespace std;
 
+/*
+ * The matrix is stored in full (both triangles) as K rows of
+ * stride floats, contiguous and aligned on 32 bytes. The rows are
+ * padded with zeros, so a row can be processed by vector operations.
+ */
 class ScoringMatrix
 {
 protected:
 	string alphabet;
-	float ** matrix;
+	float * matrix;       /**< Score of each pair of symbols (K rows of stride floats) */
   bool is_set;
-	float **norm_matrix;  /**< Normalized vector of each amino acid type */
+	float * norm_matrix;  /**< Normalized vector of each amino acid type (K rows of stride floats) */
+	int stride;           /**< Size of a row (alphabet size rounded up to 8) */
+	int sym_pos[256];     /**< Index of each symbol in the alphabet (-1 if unknown) */
 	float max;
 	float min;
 	
+	void setAlphabet(const string & alph);	/**< Set the alphabet and allocate the matrices */
+	void readText(const string & fname);		/**< Read the AAindex text file */
+	bool readCache(const string & fname);		/**< Read the binary cache of fname if it is up to date */
+	void writeCache(const string & fname);	/**< Write the binary cache of fname */
+	static string cacheName(const string & fname);
+	
+	ScoringMatrix(const ScoringMatrix &);		/**< Not copyable (owns the matrices) */
+	
 public:
 	ScoringMatrix(string fname);
 	virtual ~ScoringMatrix();
+	static ScoringMatrix & Get(const string & fname);	/**< The matrix of file fname, read once and shared by all the statistics */
 	int			getAlphabetSize(){return (int) alphabet.size();};
-	string	getAlphabet(){return alphabet;};
+	const string & getAlphabet() const {return alphabet;};
 	float   getMax(){return max;};
 	float		getMin(){return min;};
+	int			getStride(){return stride;};
 	int			index(char aa);
+	int			getPos(char aa){return sym_pos[(unsigned char) aa];};	/**< Index of aa or -1, no check */
 	float		score(char aa1, char aa2);
 	float		normScore(char aa1, char aa2);
+	float		normScore(int pos1, int pos2){return norm_matrix[pos1 * stride + pos2];};
+	const float * normRow(int pos){return norm_matrix + pos * stride;};	/**< Normalized scores of symbol pos against the alphabet */
 	bool		isSet(){return is_set;};
 	
 };
@@ -0,0 +1,60 @@
+/* Copyright (c) 2012 Guillaume Collet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "smooth.h"
+
+void
+prefixSums(const vector<float> & scores, vector<double> & prefix)
+{
+	int L = (int) scores.size();
+	prefix.assign(L + 1, 0.0);
+	for (int x(0); x < L; ++x){
+		prefix[x + 1] = prefix[x] + scores[x];
+	}
+}
+
+SmoothedStat :: SmoothedStat(const vector<float> & scores, const vector<double> & prefix, int window)
+{
+	int L = (int) scores.size();
+	col_stat.assign(L, 0.0);
+	for (int x(0); x < L; ++x){
+		int first = (x - window > 0) ? x - window : 0;
+		int last  = (x + window + 1 < L) ? x + window + 1 : L;
+		int nside = last - first - 1;
+		if (nside <= 0){
+			col_stat[x] = scores[x];
+			continue;
+		}
+		double side = (prefix[last] - prefix[first] - scores[x]) / nside;
+		col_stat[x] = (float) (0.5 * (scores[x] + side));
+	}
+}
+
+void
+smoothSweep(const Stat1D & base, const vector<int> & windows, vector<Stat1D *> & smoothed)
+{
+	const vector<float> & scores = base.getColStat();
+	vector<double> prefix;
+	prefixSums(scores, prefix);
+	for (int w(0); w < (int) windows.size(); ++w){
+		smoothed.push_back(new SmoothedStat(scores, prefix, windows[w]));
+	}
+}
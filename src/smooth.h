@@ -0,0 +1,48 @@
+/* Copyright (c) 2012 Guillaume Collet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __SMOOTH_H__
+#define __SMOOTH_H__
+
+#include "statistic.h"
+
+/*
+ * SmoothedStat is a column statistic smoothed over its side columns
+ * (Capra and Singh, 2007): the score of column x is the mean of its
+ * own score and of the mean score of the columns x-w..x+w other than x
+ * (only the columns inside the alignment are counted at the ends).
+ * The sums of the windows come from the prefix sums of the scores, so
+ * the cost is O(L) whatever the width.
+ */
+class SmoothedStat : public Stat1D
+{
+	public:
+		SmoothedStat(const vector<float> & scores, const vector<double> & prefix, int window);
+};
+
+/* Prefix sums of the scores: prefix[i] is the sum of scores[0..i-1] (L+1 values) */
+void prefixSums(const vector<float> & scores, vector<double> & prefix);
+
+/* Append to smoothed one statistic for each width of windows, the scores
+ * of base are summed once for all the widths */
+void smoothSweep(const Stat1D & base, const vector<int> & windows, vector<Stat1D *> & smoothed);
+
+#endif
@@ -0,0 +1,51 @@
+/* Copyright (c) 2012 Guillaume Collet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __SPAN_H__
+#define __SPAN_H__
+
+#include <cstddef>
+
+/*
+ * Span<T> is a read only view of size contiguous values owned by
+ * another object (e.g. the scores of a statistic), valid as long as
+ * the owner is alive and not recalculated.
+ */
+template <class T>
+class Span
+{
+private:
+	const T * values; /**< First value of the view */
+	size_t    count;  /**< Number of values in the view */
+
+public:
+	Span() : values(NULL), count(0) {};
+	Span(const T * values_, size_t count_) : values(values_), count(count_) {};
+
+	const T * data() const {return values;};
+	size_t    size() const {return count;};
+	bool      empty() const {return count == 0;};
+	const T * begin() const {return values;};
+	const T * end() const {return values + count;};
+	const T & operator[](size_t i) const {return values[i];};
+};
+
+#endif
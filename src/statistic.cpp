@@ -26,6 +26,17 @@
 #include "jensen.h"
 #include "kabat.h"
 #include "gap.h"
+#include "mi.h"
+#include "sca.h"
+#include "parallel.h"
+#include "alphabet.h"
+#include "arena.h"
+#include "reduce.h"
+
+#include <mutex>
+#include <iostream>
+#include <cstring>
+#include <algorithm>
 
 void AddAllStatistics()
 {
@@ -35,4 +46,397 @@ void AddAllStatistics()
 	StatisticFactory::Add<JensenStat>("jensen");
 	StatisticFactory::Add<KabatStat> ("kabat");
 	StatisticFactory::Add<GapStat>   ("gap");
+	StatisticFactory::Add<MIStat>    ("mi");
+	StatisticFactory::Add<MIAPCStat> ("mi_apc");
+	StatisticFactory::Add<SCAStat>   ("sca");
+}
+
+Statistic *
+createStatistic(const string & name)
+{
+	static once_flag registered;
+	call_once(registered, AddAllStatistics);
+	return StatisticFactory::CreateByName(name);
+}
+
+/** getGlobal()
+ *
+ * Mean score of the columns, summed by reduceSum so -g gives the same
+ * value for any number of threads.
+ */
+float
+Stat1D :: getGlobal() const
+{
+	return (float) (sumFloats(col_stat.data(), col_stat.size()) / (int) col_stat.size());
+}
+
+/* What Stat2D::calcPairs keeps (see pair_sinks) */
+#define SINK_TRIANGLE 0
+#define SINK_SPARSE   1
+#define SINK_TOP      2
+#define PAIR_LOCKS    64
+
+/* Locks of keepTile (the pairs above the threshold, the best pairs of the columns) */
+static mutex pair_lock[PAIR_LOCKS];
+
+/* Number of best pairs of each column in top format */
+static int
+topK(int ncol)
+{
+	return max(0, min(Context::Get().top_k, ncol - 1));
+}
+
+/* True if pair a (of a column, y the other column) is printed before b in top format */
+static bool
+betterPair(const PairScore & a, const PairScore & b)
+{
+	return a.score > b.score || (a.score == b.score && a.y < b.y);
+}
+
+/** write(msa, out)
+ *
+ * Print the statistic of each column, one column per line : col score
+ * (columns numbered from 1 in the whole alignment, also for a view),
+ * or the mean score with -g.
+ */
+void
+Stat1D :: write(Msa & msa, Writer & out)
+{
+	int L = (int) col_stat.size();
+	if (Context::Get().global){
+		out.real(getGlobal()).endl();
+	} else if (out.isBinary()){
+		out.header("MSTX1D", L, 1).floats(col_stat.data(), L);
+	} else {
+		for (int col(0); col < L; ++col){
+			out.integer(msa.getFirstCol() + col + 1).sep().real(col_stat[col]).endl();
+		}
+	}
+}
+
+/** printTable(names, stats, out)
+ *
+ * Print the column statistics in one file, one column per statistic.
+ * The first line gives the names of the statistics.
+ * With -g, only the global scores are printed under the names.
+ * In binary, the rows are the columns of the alignment and the values
+ * the statistics in the order of -s.
+ */
+void printTable(const vector<string> & names, const vector<Stat1D *> & stats, Writer & out, int first_col)
+{
+	int nstat = (int) stats.size();
+	int L = nstat ? (int) stats[0]->getColStat().size() : 0;
+	if (Context::Get().global){
+		for (int s(0); s < nstat; ++s){
+			if (s){
+				out.sep();
+			}
+			out.text(names[s]);
+		}
+		out.endl();
+		for (int s(0); s < nstat; ++s){
+			if (s){
+				out.sep();
+			}
+			out.real(stats[s]->getGlobal());
+		}
+		out.endl();
+	} else if (out.isBinary()){
+		out.header("MSTX1D", L, nstat);
+		for (int col(0); col < L; ++col){
+			for (int s(0); s < nstat; ++s){
+				out.binary<float>(stats[s]->getColStat()[col]);
+			}
+		}
+	} else {
+		out.text("col");
+		for (int s(0); s < nstat; ++s){
+			out.sep().text(names[s]);
+		}
+		out.endl();
+		for (int col(0); col < L; ++col){
+			out.integer(first_col + col + 1);
+			for (int s(0); s < nstat; ++s){
+				out.sep().real(stats[s]->getColStat()[col]);
+			}
+			out.endl();
+		}
+	}
+}
+
+/** calcPairs(msa)
+ *
+ * Fill cor_stat with the score of each pair of columns.
+ * The columns are cut in tiles small enough for two tiles of
+ * encoded columns to stay in cache, and the pairs of tiles are
+ * shared among the threads. For each pair, the joint weighted
+ * count p_ab = \sum_{i|msa[i][x]=a, msa[i][y]=b} w_i is built
+ * in one sweep over the two columns.
+ */
+void
+Stat2D :: calcPairs(Msa & msa)
+{
+	if (msa.isStreamed()){
+		cerr << "Pairwise statistics need the whole alignment, they cannot be calculated in stream mode (-S)\n";
+		exit(0);
+	}
+	int N = msa.getNseq();
+	int K = (int) msa.getAlphabet().size();
+	ncol = msa.getNcol();
+	sink = (Context::Get().pair_sinks && !needsTriangle()) ? (Context::Get().pair_format == "top" ? SINK_TOP : SINK_SPARSE) : SINK_TRIANGLE;
+	cor_stat.assign(sink == SINK_TRIANGLE ? (size_t) ncol * (ncol - 1) / 2 : 0, 0.0);
+	kept.clear();
+	nkept.assign(sink == SINK_TOP ? ncol : 0, 0);
+	if (sink == SINK_TOP){
+		kept.resize((size_t) ncol * topK(ncol));
+	}
+	if (ncol < 2){
+		return;
+	}
+	const vector<float> & w = msa.getSeqWeight();
+	msa.getWeightedCount(0); /* calculated once before sharing columns among threads */
+
+	/* Tiles of T columns, 2 tiles take about 256KB */
+	int T = 131072 / (N > 0 ? N : 1);
+	T = T < 4 ? 4 : (T > 64 ? 64 : T);
+	int ntile = (ncol + T - 1) / T;
+	vector<pair<int,int> > tiles;
+	for (int tx(0); tx < ntile; ++tx){
+		for (int ty(tx); ty < ntile; ++ty){
+			tiles.push_back(make_pair(tx, ty));
+		}
+	}
+
+	/* The rows of the joint counts have the size of the alphabet class
+	 * (a constant for nucleotides and proteins), or K for generic alphabets.
+	 * For nucleotides, the few pairs of symbols are hit by nearly every
+	 * sequence: the rows are summed in 4 tables (seq % 4) added at the end,
+	 * so the additions on a same pair do not wait for each other. */
+	dispatchAlphabet(K, [&](auto kmax){
+		constexpr int KMAX = decltype(kmax)::value;
+		constexpr int WAYS = KMAX == NUCLEOTIDE_ALPHABET ? 4 : 1;
+		const int S = KMAX <= PROTEIN_ALPHABET ? KMAX : K;
+		const size_t SS = (size_t) S * S;
+		parallelFor(0, (int) tiles.size(), [&](int first, int last){
+			Scratch scratch;
+			float * joint = scratch.get<float>(WAYS * SS);
+			/* Columns of the two tiles (unpacked once per tile if the alignment is packed) */
+			uint8_t * buf_x = msa.isPacked() ? scratch.get<uint8_t>((size_t) T * N) : NULL;
+			uint8_t * buf_y = msa.isPacked() ? scratch.get<uint8_t>((size_t) T * N) : NULL;
+			const uint8_t ** cols_y = scratch.get<const uint8_t *>(T);
+			PairScore * pairs = sink != SINK_TRIANGLE ? scratch.get<PairScore>((size_t) T * T) : NULL;
+			for (int t(first); t < last; ++t){
+				int npair = 0;
+				int x0 = tiles[t].first * T, y0 = tiles[t].second * T;
+				int x_end = min(ncol, x0 + T);
+				int y_end = min(ncol, y0 + T);
+				for (int y(y0); y < y_end; ++y){
+					cols_y[y - y0] = msa.getColumn(y, buf_y ? buf_y + (size_t) (y - y0) * N : NULL);
+				}
+				for (int x(x0); x < x_end; ++x){
+					const uint8_t * col_x = (x >= y0) ? cols_y[x - y0] : msa.getColumn(x, buf_x ? buf_x + (size_t) (x - x0) * N : NULL);
+					for (int y(max(x + 1, y0)); y < y_end; ++y){
+						const uint8_t * col_y = cols_y[y - y0];
+						memset(joint, 0, WAYS * SS * sizeof(float));
+						int seq(0);
+						if (WAYS == 4){
+							float * j0 = joint;
+							float * j1 = j0 + SS;
+							float * j2 = j1 + SS;
+							float * j3 = j2 + SS;
+							for (; seq + 4 <= N; seq += 4){
+								j0[col_x[seq]     * S + col_y[seq]]     += w[seq];
+								j1[col_x[seq + 1] * S + col_y[seq + 1]] += w[seq + 1];
+								j2[col_x[seq + 2] * S + col_y[seq + 2]] += w[seq + 2];
+								j3[col_x[seq + 3] * S + col_y[seq + 3]] += w[seq + 3];
+							}
+						}
+						for (; seq < N; ++seq){
+							joint[col_x[seq] * S + col_y[seq]] += w[seq];
+						}
+						if (WAYS == 4){
+							for (size_t ab(0); ab < SS; ++ab){
+								joint[ab] = (joint[ab] + joint[SS + ab]) + (joint[2 * SS + ab] + joint[3 * SS + ab]);
+							}
+						}
+						float score = pairScore(msa, x, y, joint, S);
+						if (pairs){
+							PairScore pair = {x, y, score};
+							pairs[npair++] = pair;
+						} else {
+							cor_stat[pairIndex(x, y)] = score;
+						}
+					}
+				}
+				if (pairs){
+					keepTile(pairs, npair);
+				}
+			}
+		});
+	});
+	if (sink == SINK_SPARSE){
+		sort(kept.begin(), kept.end(), [](const PairScore & a, const PairScore & b){
+			return a.x < b.x || (a.x == b.x && a.y < b.y);
+		});
+	}
+}
+
+/** keepTile(pairs, npair)
+ *
+ * Keeps the pairs of a tile which are printed : in sparse format the
+ * pairs above the threshold, in top format the pair is a candidate for
+ * the best pairs of x and of y. The best pairs of a column are a heap
+ * (the worst one first) of at most topK() pairs; they are updated under
+ * the lock of the column, and the pairs kept do not depend on the order
+ * of the tiles since the order of the pairs is total (see betterPair).
+ */
+void
+Stat2D :: keepTile(const PairScore * pairs, int npair)
+{
+	if (sink == SINK_SPARSE){
+		float threshold = Context::Get().threshold;
+		lock_guard<mutex> guard(pair_lock[0]);
+		for (int p(0); p < npair; ++p){
+			if (pairs[p].score >= threshold){
+				kept.push_back(pairs[p]);
+			}
+		}
+		return;
+	}
+	int k = topK(ncol);
+	if (k == 0){
+		return;
+	}
+	for (int p(0); p < npair; ++p){
+		for (int side(0); side < 2; ++side){
+			int col = side ? pairs[p].y : pairs[p].x;
+			/* The pair is kept as (col, other column) */
+			PairScore cand = {col, side ? pairs[p].x : pairs[p].y, pairs[p].score};
+			PairScore * heap = &kept[(size_t) col * k];
+			lock_guard<mutex> guard(pair_lock[col % PAIR_LOCKS]);
+			if (nkept[col] < k){
+				heap[nkept[col]++] = cand;
+				push_heap(heap, heap + nkept[col], betterPair);
+			} else if (betterPair(cand, heap[0])){
+				pop_heap(heap, heap + k, betterPair);
+				heap[k - 1] = cand;
+				push_heap(heap, heap + k, betterPair);
+			}
+		}
+	}
+}
+
+/** write(msa, out)
+ *
+ * Print the pairs of columns in the format given by -f :
+ *  - sparse : the pairs with a score above the threshold (-t),
+ *             one pair per line : x y score (columns numbered from 1 in the whole alignment)
+ *  - dense  : the upper triangle as a matrix (0 in the lower triangle)
+ *  - top    : the -k best pairs of each column, x y score
+ *  - bin    : the packed upper triangle in binary (see printBinary)
+ * With -F bin, the binary format is used whatever -f is.
+ * With -g, only the mean score of all the pairs is printed.
+ */
+void
+Stat2D :: write(Msa & msa, Writer & out)
+{
+	const string & format = Context::Get().pair_format;
+	if (Context::Get().global){
+		double total = sumFloats(cor_stat.data(), cor_stat.size());
+		out.real(cor_stat.empty() ? 0.0 : (float) (total / cor_stat.size())).endl();
+	} else if (format == "bin" || out.isBinary()){
+		printBinary(out);
+	} else if (format == "dense"){
+		printDense(out);
+	} else if (format == "top"){
+		printTop(out, msa.getFirstCol() + 1);
+	} else {
+		printSparse(out, msa.getFirstCol() + 1);
+	}
+}
+
+void
+Stat2D :: printSparse(Writer & out, int base)
+{
+	if (sink == SINK_SPARSE){
+		for (size_t p(0); p < kept.size(); ++p){
+			out.integer(kept[p].x + base).sep().integer(kept[p].y + base).sep().real(kept[p].score).endl();
+		}
+		return;
+	}
+	float threshold = Context::Get().threshold;
+	for (int x(0); x < ncol - 1; ++x){
+		for (int y(x + 1); y < ncol; ++y){
+			float score = cor_stat[pairIndex(x, y)];
+			if (score >= threshold){
+				out.integer(x + base).sep().integer(y + base).sep().real(score).endl();
+			}
+		}
+	}
+}
+
+void
+Stat2D :: printDense(Writer & out)
+{
+	for (int x(0); x < ncol - 1; ++x) {
+		for (int y(0); y < ncol; ++y) {
+			out.real(y > x ? cor_stat[pairIndex(x, y)] : 0.0).sep();
+		}
+		out.endl();
+	}
+}
+
+/* For each column x, the k columns y with the best scores,
+ * sorted by decreasing score (by column for equal scores) */
+void
+Stat2D :: printTop(Writer & out, int base)
+{
+	int k = topK(ncol);
+	if (sink == SINK_TOP){
+		for (int x(0); x < ncol; ++x){
+			PairScore * heap = &kept[(size_t) x * k];
+			sort(heap, heap + nkept[x], betterPair);
+			for (int i(0); i < nkept[x]; ++i){
+				out.integer(x + base).sep().integer(heap[i].y + base).sep().real(heap[i].score).endl();
+			}
+		}
+		return;
+	}
+	vector<int> others;
+	for (int x(0); x < ncol; ++x){
+		others.clear();
+		for (int y(0); y < ncol; ++y){
+			if (y != x){
+				others.push_back(y);
+			}
+		}
+		partial_sort(others.begin(), others.begin() + k, others.end(), [&](int y1, int y2){
+			float s1 = getPair(x, y1);
+			float s2 = getPair(x, y2);
+			return s1 > s2 || (s1 == s2 && y1 < y2);
+		});
+		for (int i(0); i < k; ++i){
+			out.integer(x + base).sep().integer(others[i] + base).sep().real(getPair(x, others[i])).endl();
+		}
+	}
+}
+
+/* Binary format, all numbers are little-endian :
+ *   8 bytes  : magic "MSTX2D" padded with 0
+ *   uint32_t : version (1)
+ *   uint32_t : number of columns L
+ *   uint64_t : number of pairs L(L-1)/2
+ *   float32  : score of each pair (x < y), row by row :
+ *              (0,1) (0,2) ... (0,L-1) (1,2) ... (L-2,L-1)
+ * The header is 24 bytes, so the scores can be mapped as an array of floats.
+ */
+void
+Stat2D :: printBinary(Writer & out)
+{
+	const char magic[8] = {'M', 'S', 'T', 'X', '2', 'D', 0, 0};
+	out.text(string(magic, 8));
+	out.binary<uint32_t>(1);
+	out.binary<uint32_t>((uint32_t) ncol);
+	out.binary<uint64_t>((uint64_t) cor_stat.size());
+	out.floats(cor_stat.data(), cor_stat.size());
 }
@@ -24,11 +24,12 @@
 
 #include <vector>
 #include <string>
-#include <fstream>
 
 #include "msa.h"
-#include "options.h"
+#include "context.h"
 #include "factory.h"
+#include "writer.h"
+#include "span.h"
 
 using namespace std;
 
@@ -38,13 +39,23 @@ public:
 	Statistic(){};
 	virtual ~Statistic(){};
 	virtual void calculate(Msa & msa){};
-	virtual void print(Msa & msa){};
+	virtual void write(Msa & msa, Writer & out){};	/**< Write the results */
+	virtual Span<float> getScores() const {return Span<float>();};	/**< The results of calculate, without copy (layout given by each kind of statistic) */
+	void print(Msa & msa, const string & fname){Writer out(fname); write(msa, out);};	/**< Write the results in file fname */
 };
 
 class StatisticFactory : public Factory<Statistic>{};
 
+class Stat1D;
+
 void AddAllStatistics();
 
+/* Create the statistic of this name (registers all the statistics once, throws if unknown) */
+Statistic * createStatistic(const string & name);
+
+/* Print several column statistics side by side in one table (first_col is the position of column 0 in the whole alignment) */
+void printTable(const vector<string> & names, const vector<Stat1D *> & stats, Writer & out, int first_col = 0);
+
 class Stat1D : public Statistic {
 protected:
 	vector<float> col_stat; /**< vector to store columns statistics */
@@ -52,52 +63,57 @@ protected:
 public:
 	virtual ~Stat1D(){};
 	virtual void calculate(Msa & msa){};
-	void print(Msa & msa){
-		ofstream file(Options::Get().output_fname.c_str());
-		if (!file.is_open()){
-			cerr << "Cannot open file " << Options::Get().output_fname << "\n";
-			exit(0);
-		}
-		if (Options::Get().global){
-			float total = 0.0;
-			for (int col(0); col < (int) col_stat.size(); ++col){
-				total += col_stat[col];
-			}
-			file << total / (int) col_stat.size() << "\n";
-		} else {
-			for (int col(0); col < (int) col_stat.size(); ++col){
-				file << col + 1 << "\t" << col_stat[col] << "\n";
-			}
-		}
-		file.close();
-	};
+	const vector<float> & getColStat() const {return col_stat;};
+	Span<float> getScores() const {return Span<float>(col_stat.data(), col_stat.size());};	/**< One score per column */
+	float getGlobal() const;	/**< Mean score of the columns (the same whatever the number of threads) */
+	void write(Msa & msa, Writer & out);
+};
+
+/* A pair of columns (x < y) and its score */
+struct PairScore
+{
+	int   x;
+	int   y;
+	float score;
 };
 
+/*
+ * Stat2D is a statistic on pairs of columns (x, y) with x < y.
+ * The scores are stored in the upper triangle packed row by row
+ * (L(L-1)/2 floats). calcPairs() builds the weighted joint histogram of
+ * each pair by tiles of columns shared among the threads and calls
+ * pairScore() on it.
+ * With pair_sinks in the context (sparse or top output), only the
+ * pairs printed are kept while the tiles are calculated: the pairs
+ * above the threshold or the -k best pairs of each column, so the
+ * memory does not grow as L² (the triangle is then empty).
+ */
 class Stat2D : public Statistic {
 protected:
-	vector< vector<float> > cor_stat; /**< vector to store pairs of columns statistics */
+	int ncol;                 /**< Number of columns of the alignment */
+	vector<float> cor_stat;   /**< Packed upper triangle of pairs of columns statistics (empty if only the pairs printed are kept) */
+	vector<PairScore> kept;   /**< Pairs above the threshold sorted by (x, y) (sparse), or the best pairs of each column, top_k per column (top) */
+	vector<int> nkept;        /**< Number of best pairs kept for each column (top) */
+	int  sink;                /**< What calcPairs keeps: the triangle, the pairs above the threshold or the best pairs */
+
+	size_t pairIndex(int x, int y) const {return (size_t) x * (2 * ncol - x - 1) / 2 + (y - x - 1);};	/**< Position of pair (x < y) in cor_stat */
+	void calcPairs(Msa & msa);	/**< Calculate the score of all the pairs of columns */
+	void keepTile(const PairScore * pairs, int npair);	/**< Keep the pairs of a tile printed in sparse or top format */
+	void printSparse(Writer & out, int base);	/**< Print the pairs above the threshold (columns numbered from base) */
+	void printDense(Writer & out);	/**< Print the upper triangle as a matrix */
+	void printTop(Writer & out, int base);		/**< Print the best pairs of each column (columns numbered from base) */
+	void printBinary(Writer & out);	/**< Write the packed upper triangle in binary */
+	virtual float pairScore(Msa & msa, int x, int y, const float * joint, int stride){return 0.0;};	/**< Score of pair (x,y) from the joint weighted counts (K rows of stride values) */
+	virtual bool needsTriangle() const {return false;};	/**< True if calculate() needs all the pairs (e.g. a correction by the means) */
 
 public:
+	Stat2D() : ncol(0), sink(0) {};
 	virtual ~Stat2D(){};
 	virtual void calculate(Msa & msa){};
-	void print(Msa & msa){
-		ofstream file(Options::Get().output_fname.c_str());
-		if (!file.is_open()){
-			cerr << "Cannot open file " << Options::Get().output_fname << "\n";
-			exit(0);
-		}
-		for  (int x(0); x < (int) cor_stat.size() - 1; ++x) {
-			for (int y(0); y < (int) cor_stat.size(); ++y) {
-				if (y > x){
-					file << cor_stat[x][y] << "\t";
-				} else {
-					file << 0.0 << "\t";
-				}
-			}
-			file << "\n";
-		}
-		file.close();
-	};
+	float getPair(int x, int y) const {return x < y ? cor_stat[pairIndex(x, y)] : cor_stat[pairIndex(y, x)];};	/**< Score of pair (x,y), x != y (whole triangle only) */
+	Span<float> getScores() const {return Span<float>(cor_stat.data(), cor_stat.size());};	/**< The packed upper triangle, pairs (0,1), (0,2) ... (L-2,L-1) (empty with pair_sinks) */
+	int getNcol() const {return ncol;};	/**< Number of columns of the last alignment */
+	void write(Msa & msa, Writer & out);
 };
 
 #endif
@@ -20,8 +20,11 @@
  */
 
 #include "trident.h"
-#include "options.h"
+#include "context.h"
 #include "scoring_matrix.h"
+#include "parallel.h"
+#include "kernels.h"
+#include "arena.h"
 
 #include <cmath>
 #include <fstream>
@@ -29,52 +32,6 @@
 
 #define MIN(x,y)  (x < y ? x : y)
 
-/** calcSeqWeight(Msa & msa, int i)
- *
- * Calculate the weight of sequence i in the multiple sequence alignment
- * by the formula from Henikoff & Henikoff (1994)
- * w_i = \frac{1}{L}\sum_{x=1}^{L}\frac{1}{k_x n_{x_i}} (LateX code)
- * We use these notations in the code below
- */
-float
-TridStat :: calcSeqWeight(Msa & msa, int i)
-{
-	int x;                 /**< used to parse msa columns */
-	int seq;               /**< used to parse msa rows */
-	int k;                 /**< number of symbol types in a column */
-	int n;                 /**< number of occurence of aa[i][x] in the full column x */
-	int L = msa.getNcol(); /**< number of columns (length of the alignment) */
-	int N = msa.getNseq(); /**< number of rows (number of sequences in the alignment) */
-	float w;               /**< weight of sequence i */
-
-	w = 0.0;
-	for	(x = 0; x < L; ++x){
-		k = msa.getNtype(x);
-		n = 0;
-		for(seq = 0; seq < N; ++seq){
-			if (msa.getSymbol(i, x) == msa.getSymbol(seq, x)){
-				n++;
-			}
-		}
-		w += (float) 1 / (float) (n * k);
-	}
-	w /= (float) L;
-	return w ;
-}
-
-/** normVect(vector<float> vect)
- *
- * Return the vector norm = √(∑v*v)
- */
-float
-TridStat :: normVect(vector<float> vect){
-	float score= 0.0;
-	for(int i(0); i < (int) vect.size(); ++i){
-		score += vect[i] * vect[i];
-	}
-	return sqrt(score);
-}
-
 /** calculate(Msa & msa)
  *
  * Calculate trident statistic and print it in the output file
@@ -92,7 +49,6 @@ void
 TridStat :: calculate(Msa & msa)
 {
 	/* Declare the vectors */
-	vector<float> w;					/**< Weight of each sequence in the msa (size = nb sequences) */
 	vector<float> t;					/**< t(x) = Shannon entropy score  + Weighted sequence Score */
 	vector<float> r;					/**< r(x) = Stereochemical score */
 	vector<float> g;					/**< g(x) = Gap Score */
@@ -100,46 +56,39 @@ TridStat :: calculate(Msa & msa)
 	/* Init size */
 	int L = msa.getNcol();
 	int N = msa.getNseq();
-	string alphabet = msa.getAlphabet();
+	const string & alphabet = msa.getAlphabet();
 	int K = (int) alphabet.size();
 
-  //cerr << "Seq Weights\n";
-	/* Calculate Sequence Weights */
-	for (int seq(0); seq < N; ++seq){
-		w.push_back(calcSeqWeight(msa,seq));
-	}
-
 	/* Calculate t(x) = \frac{\sum_{a=1}^{K}p_a log(p_a)}{log(min(N,K))}
 	 *						p_a = \sum_{i \in \{i|s(i) = a\}} w_i
 	 *						w_i = \frac{1}{L} \sum_{x=1}^{L}\frac{1}{K_x n_{x_i}}
-	 * Like in wentropy
+	 * Like in wentropy, p_a is the weighted count of a in the column
 	 */
 	float lambda = 1.0 / log(MIN(K,N));
 
-  for (int x(0); x < L; x++){
-		t.push_back(0.0);
-		for (int a(0); a < K; a++){
-			float tmp_proba(0.0);
-		  for (int j(0); j < N; j++){
-				if(msa.getSymbol(j, x) == alphabet[a]){
-					tmp_proba += w[j];
+	msa.getWeightedCount(0); /* calculated once before sharing columns among threads */
+	t.assign(L, 0.0);
+	parallelFor(0, L, [&](int first, int last){
+		for (int x(first); x < last; x++){
+			const float * p = msa.getWeightedCount(x);
+			for (int a(0); a < K; a++){
+				if (p[a] != 0.0){
+					t[x] -= p[a] * log(p[a]);
 				}
 			}
-			if (tmp_proba != 0.0){
-				t[x] -= tmp_proba * log(tmp_proba);
-			}
+			t[x] *= lambda;
 		}
-		t[x] *= lambda;
-    //cerr << "t[" << x << "] = " << t[x] << "\n";
-	}
+	});
 
 	/* Calculate g(x) = nb_gap / nb_seq
 	 * Represents the proportion of gaps in the column
 	 */
-	for (int x(0); x < L; x++){
-		g.push_back((float) msa.getGap(x) / (float) N);
-		//cerr << "g[" << x << "] = " << g[x] << "\n";
-	}
+	g.assign(L, 0.0);
+	parallelFor(0, L, [&](int first, int last){
+		for (int x(first); x < last; x++){
+			g[x] = (float) msa.getGap(x) / (float) N;
+		}
+	});
 
 
 	/* Calculate r(x) = \lambda_r \frac{1}{k_x}\sum_{a=1}^{k_x}|\bar{X}(x) - X_a|
@@ -147,61 +96,66 @@ TridStat :: calculate(Msa & msa)
 	 *					  X_a = \left[ \begin{array}{c}M(a,a_1)\\M(a,a_2)\\.\\.\\.\\M(a,a_{20})\end{array}\right]
 	 *							M is a normalized scoring matrix
 	 */
-	ScoringMatrix score_mat(Options::Get().matrix_fname);
+	ScoringMatrix & score_mat = ScoringMatrix::Get(Context::Get().matrix_fname);
 	int alph_size = score_mat.getAlphabetSize();
-	string sm_alphabet = score_mat.getAlphabet();
-
-	//msa.fitToAlphabet(sm_alphabet);
 
-	for (int x(0); x < L; x++){
-
-		int ntype = msa.getNtype(x);
-		string type_list = msa.getTypeList(x);
-		if (type_list.empty()) {
-			std::cerr << "Error: No amino acid type found in column " << x << "\n";
-			exit(1);
-		}
-		if (type_list.find("-") < (int) type_list.size()){
-			type_list.erase(type_list.find("-"), 1);
-			ntype--;
+	/* Index of each symbol of the alignment in the scoring matrix
+	 * (gaps and symbols unknown by the matrix are -1 and skipped) */
+	vector<int> sm_pos(K, -1);
+	for (int a(0); a < K; ++a){
+		if (alphabet[a] != '-'){
+			sm_pos[a] = score_mat.getPos(alphabet[a]);
 		}
-		if (ntype){
-			/* Calculate Mean vector */
-			vector<float> mean(alph_size, 0.0);
-			for (int i(0); i < ntype; ++i){
-				for (int a(0); a < alph_size; ++a){
-					mean[a] += score_mat.normScore(sm_alphabet[a], type_list[i]);
+	}
+	float lambda_r = sqrt(alph_size * (score_mat.getMax() - score_mat.getMin()) * (score_mat.getMax() - score_mat.getMin()));
+
+	int stride = score_mat.getStride();
+
+	r.assign(L, 0.0);
+	parallelFor(0, L, [&](int first, int last){
+		Scratch scratch;
+		const float ** rows = scratch.get<const float *>(K);
+		float * mean = scratch.get<float>(stride);
+		for (int x(first); x < last; x++){
+			/* List the rows of the amino acid types of the column */
+			Span<uint8_t> types = msa.getTypes(x);
+			int ntype = 0;
+			for (size_t i(0); i < types.size(); ++i){
+				if (sm_pos[types[i]] >= 0){
+					rows[ntype++] = score_mat.normRow(sm_pos[types[i]]);
 				}
 			}
-			for (int a(0); a < alph_size; ++a){
-				mean[a] /= ntype;
-			}
+			if (ntype){
+				/* Calculate Mean vector */
+				fill(mean, mean + stride, 0.0);
+				for (int i(0); i < ntype; ++i){
+					addScaledRow(mean, rows[i], 1.0, stride);
+				}
+				for (int a(0); a < alph_size; ++a){
+					mean[a] /= ntype;
+				}
 
-			/* Calculate Score */
-			float lambda = sqrt(alph_size * (score_mat.getMax() - score_mat.getMin()) * (score_mat.getMax() - score_mat.getMin()));
-			float tmp_score = 0.0;
-			for (int i(0); i < ntype; ++i){
-				vector<float> diff_vect;
-				for(int a(0); a < alph_size; ++a){
-					diff_vect.push_back(mean[a] - score_mat.normScore(sm_alphabet[a], type_list[i]));
+				/* Calculate Score = mean distance to the mean vector */
+				float tmp_score = 0.0;
+				for (int i(0); i < ntype; ++i){
+					tmp_score += distance(mean, rows[i], stride);
 				}
-				tmp_score += normVect(diff_vect);
+				tmp_score /= ntype;
+				tmp_score /= lambda_r;
+				r[x] = tmp_score;
 			}
-			tmp_score /= ntype;
-			tmp_score /= lambda;
-			r.push_back(tmp_score);
-		} else {
-			r.push_back(0.0);
 		}
-    //cerr << "r[" << x << "] = " << r[x] << "\n";
-	}
+	});
 
 
 	/*
 	 * Combine the three scores
 	 */
-	for (int x(0); x < L; x++){
-		col_stat.push_back(pow((1-t[x]),Options::Get().factor_a)*pow((1-r[x]),Options::Get().factor_b)*pow((1-g[x]),Options::Get().factor_c));
-	}
+	col_stat.assign(L, 0.0);
+	parallelFor(0, L, [&](int first, int last){
+		for (int x(first); x < last; x++){
+			col_stat[x] = pow((1-t[x]),Context::Get().factor_a)*pow((1-r[x]),Context::Get().factor_b)*pow((1-g[x]),Context::Get().factor_c);
+		}
+	});
 
 }
@@ -25,10 +25,6 @@
 #include "statistic.h"
 
 class TridStat : public Stat1D {
-private:
-	float calcSeqWeight(Msa & msa, int i);
-	float normVect(vector<float> vect);
-	
 public:
 	void calculate(Msa & msa);
 };
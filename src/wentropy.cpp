@@ -20,7 +20,8 @@
  */
 
 #include "wentropy.h"
-#include "options.h"
+#include "context.h"
+#include "parallel.h"
 
 #include <cmath>
 #include <fstream>
@@ -29,40 +30,6 @@
 #define MIN(x,y)  (x < y ? x : y)
 
 
-/** calcSeqWeight(Msa & msa, int i)
- *
- * Calculate the weight of sequence i in the multiple sequence alignment
- * by the formula from Henikoff & Henikoff (1994)
- * w_i = \frac{1}{L}\sum_{x=1}^{L}\frac{1}{k_x n_{x_i}} (LateX code)
- * We use these notations in the code below
- */
-float
-WEntStat :: calcSeqWeight(Msa & msa, int i)
-{
-	int x;                 /**< used to parse msa columns */
-	int seq;               /**< used to parse msa rows */
-	int k;                 /**< number of symbol types in a column */
-	int n;                 /**< number of occurence of aa[i][x] in the full column x */
-	int L = msa.getNcol(); /**< number of columns (length of the alignment) */
-	int N = msa.getNseq(); /**< number of rows (number of sequences in the alignment) */
-	float w;               /**< weight of sequence i */
-	
-	w = 0.0;
-	for	(x = 0; x < L; ++x){
-		k = msa.getNtype(x);
-		n = 0;
-		for(seq = 0; seq < N; ++seq){
-			if (msa.getSymbol(i, x) == msa.getSymbol(seq, x)){
-				n++;
-			}
-		}
-		w += (float) 1 / (float) (n * k);
-	}
-	w /= (float) L;
-	return w ;
-}
-
-
 /** calculate(Msa & msa)
  *
  * Calculate wentropy statistic and print it in the output file
@@ -77,53 +44,28 @@ WEntStat :: calcSeqWeight(Msa & msa, int i)
 void
 WEntStat :: calculate(Msa & msa)
 {
-	string alphabet = msa.getAlphabet();
+	const string & alphabet = msa.getAlphabet();
 	
 	/* Init sizes */
 	int L = msa.getNcol();
 	int N = msa.getNseq();
 	int K = (int) alphabet.size();
 	
-	/* Allocate probabilities array */
-	float ** p = (float **) calloc (L, sizeof(float*));
-	if (p == NULL){
-		fprintf(stderr,"Cannot Allocate probability matrix\n");
-		exit(0);
-	}
-	for (int i(0); i < L; i++){
-		p[i] = (float *) calloc (K, sizeof(float));
-		if (p[i] == NULL){
-			fprintf(stderr,"Cannot Allocate probability submatrix\n");
-			exit(0);
-		}
-	}
-	
-	/* Calculate Sequence Weights */
-	vector<float> w;
-	for (int seq(0); seq < N; ++seq){
-		w.push_back(calcSeqWeight(msa,seq));
-	}
-	
-	/* Calculate aa proba and conservation score by columns */
+	/* Calculate aa proba and conservation score by columns
+	 * p_a is the weighted count of a in the column */
 	float lambda = 1.0 / log(MIN(K,N));
 	
-	for (int x(0); x < L; ++x){
-		col_stat.push_back(0.0);
-		for (int a(0); a < K; ++a){
-			for (int j(0); j < N; ++j){
-				if(msa.getSymbol(j, x) == alphabet[a]){
-					p[x][a] += w[j];
+	msa.getWeightedCount(0); /* calculated once before sharing columns among threads */
+	col_stat.assign(L, 0.0);
+	parallelFor(0, L, [&](int first, int last){
+		for (int x(first); x < last; ++x){
+			const float * p = msa.getWeightedCount(x);
+			for (int a(0); a < K; ++a){
+				if (p[a] != 0.0){
+					col_stat[x] -= p[a] * log(p[a]);
 				}
 			}
-			if (p[x][a] != 0.0){
-				col_stat[x] -= p[x][a] * log(p[x][a]);
-			}
+			col_stat[x] *= lambda;
 		}
-		col_stat[x] *= lambda;
-	}
-	
-	for (int i(0); i < L; ++i) {
-		free (p[i]);
-	}
-	free(p);
+	});
 }
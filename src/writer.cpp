@@ -0,0 +1,155 @@
+/* Copyright (c) 2012 Guillaume Collet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "writer.h"
+#include "profile.h"
+#include "context.h"
+
+#include <charconv>
+#include <iostream>
+
+#define BUFFER_SIZE (1 << 20)
+
+Writer :: Writer(const string & name) : memory(NULL), fname(name), buffer(BUFFER_SIZE), used(0)
+{
+	file = fopen(fname.c_str(), "wb");
+	if (file == NULL){
+		cerr << "Cannot open file " << fname << "\n";
+		exit(0);
+	}
+	separator = Context::Get().out_format == "csv" ? ',' : '\t';
+}
+
+Writer :: Writer(string * mem) : file(NULL), memory(mem), buffer(BUFFER_SIZE), used(0)
+{
+	separator = Context::Get().out_format == "csv" ? ',' : '\t';
+}
+
+Writer :: ~Writer()
+{
+	flush();
+	if (file != NULL){
+		fclose(file);
+	}
+}
+
+bool
+Writer :: isBinary() const
+{
+	return Context::Get().out_format == "bin";
+}
+
+void
+Writer :: flush()
+{
+	if (memory != NULL){
+		memory->append(&buffer[0], used);
+	} else if (used && fwrite(&buffer[0], 1, used, file) != used){
+		cerr << "Cannot write in file " << fname << "\n";
+		exit(0);
+	} else {
+		Profile::addBytes("output", used);
+	}
+	used = 0;
+}
+
+char *
+Writer :: reserve(size_t size)
+{
+	if (used + size > buffer.size()){
+		flush();
+		if (size > buffer.size()){
+			buffer.resize(size);
+		}
+	}
+	char * dst = &buffer[used];
+	used += size;
+	return dst;
+}
+
+void
+Writer :: field(const char * str, size_t len, int width)
+{
+	size_t pad = (width > 0 && (size_t) width > len) ? width - len : 0;
+	char * dst = reserve(pad + len);
+	memset(dst, ' ', pad);
+	memcpy(dst + pad, str, len);
+}
+
+Writer &
+Writer :: text(const string & str, int width)
+{
+	field(str.data(), str.size(), width);
+	return *this;
+}
+
+Writer &
+Writer :: chr(char c, int width)
+{
+	field(&c, 1, width);
+	return *this;
+}
+
+Writer &
+Writer :: integer(long value, int width)
+{
+	char str[24];
+	char * end = to_chars(str, str + sizeof(str), value).ptr;
+	field(str, end - str, width);
+	return *this;
+}
+
+/* Same text as ostream << value with this precision (printf %g) */
+Writer &
+Writer :: real(float value, int precision, int width)
+{
+	char str[64];
+	char * end = to_chars(str, str + sizeof(str), value, chars_format::general, precision).ptr;
+	field(str, end - str, width);
+	return *this;
+}
+
+Writer &
+Writer :: floats(const float * values, size_t size)
+{
+	if (isLittleEndian()){
+		memcpy(reserve(size * sizeof(float)), values, size * sizeof(float));
+	} else {
+		for (size_t i(0); i < size; ++i){
+			binary<float>(values[i]);
+		}
+	}
+	return *this;
+}
+
+Writer &
+Writer :: header(const char * magic, uint32_t nrow, uint32_t nval)
+{
+	/* The magic is padded with 0 up to 8 bytes */
+	char field[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+	memcpy(field, magic, strnlen(magic, 8));
+	memcpy(reserve(8), field, 8);
+	binary<uint32_t>(1);
+	binary<uint32_t>(nrow);
+	binary<uint32_t>(nval);
+	binary<uint32_t>(0);
+	return *this;
+}
@@ -0,0 +1,110 @@
+/* Copyright (c) 2012 Guillaume Collet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __WRITER_H__
+#define __WRITER_H__
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+
+using namespace std;
+
+/*
+ * Writer formats the results in a large buffer written to the file
+ * when it is full, floats are converted by std::to_chars.
+ * The text output is the same as with ofstream (6 significant digits
+ * by default), the separator of the fields depends on the format
+ * given by -F :
+ *   - tsv : fields separated by tabulations (default)
+ *   - csv : fields separated by commas
+ *   - bin : binary output, written by binary() and floats()
+ * All binary numbers are little-endian.
+ */
+class Writer
+{
+private:
+	FILE * file;             /**< Output file (NULL when writing in memory) */
+	string * memory;         /**< Output string (NULL when writing in a file) */
+	string fname;
+	vector<char> buffer;
+	size_t used;             /**< Number of bytes used in buffer */
+	char separator;          /**< Separator of the fields in text mode */
+
+	char * reserve(size_t size);	/**< Space for size bytes at the end of the buffer */
+	void field(const char * str, size_t len, int width);	/**< Append str right aligned on width characters */
+
+public:
+	Writer(const string & fname);
+	Writer(string * memory);	/**< Append the output to the string memory */
+	~Writer();
+
+	bool isBinary() const;	/**< True with -F bin */
+	char getSeparator() const {return separator;};
+
+	Writer & text(const string & str, int width = 0);
+	Writer & chr(char c, int width = 0);
+	Writer & integer(long value, int width = 0);
+	Writer & real(float value, int precision = 6, int width = 0);
+	Writer & sep() {return chr(separator);};	/**< Append the field separator */
+	Writer & endl() {return chr('\n');};
+
+	template <class T> Writer & binary(T value);	/**< Append value in little-endian */
+	Writer & floats(const float * values, size_t size);	/**< Append an array of float32 */
+	Writer & header(const char * magic, uint32_t nrow, uint32_t nval);	/**< Binary header of a table of nrow * nval floats, magic of at most 8 chars */
+
+	void flush();
+};
+
+/* Binary header of tables:
+ *   8 bytes  : magic padded with 0 ("MSTX1D" for tables of column statistics)
+ *   uint32_t : version (1)
+ *   uint32_t : number of rows
+ *   uint32_t : number of values per row
+ *   uint32_t : 0
+ * followed by the rows of float32 (24 bytes of header keep the floats aligned)
+ */
+
+inline bool
+isLittleEndian()
+{
+	uint16_t one = 1;
+	return *(uint8_t *) &one == 1;
+}
+
+template <class T> Writer &
+Writer :: binary(T value)
+{
+	char * dst = reserve(sizeof(T));
+	memcpy(dst, &value, sizeof(T));
+	if (!isLittleEndian()){
+		for (size_t i(0); i < sizeof(T) / 2; ++i){
+			char tmp = dst[i];
+			dst[i] = dst[sizeof(T) - 1 - i];
+			dst[sizeof(T) - 1 - i] = tmp;
+		}
+	}
+	return *this;
+}
+
+#endif